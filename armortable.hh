@@ -0,0 +1,1089 @@
+///////////////////////////////////////////////////////////////////////////////
+// armortable.hh
+//
+// Column-oriented armor catalog: cost, defense and description attributes
+// kept in parallel arrays, for filtering large catalogs without going
+// through one ArmorItem per row.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "maxdefense.hh"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+// Row numbers of an ArmorTable, e.g. the rows that match a filter, in increasing order.
+typedef std::vector<uint32_t> RowSelection;
+
+
+// The attributes encoded in a description such as "deteriorating poor quality enchanted elf shield":
+// condition, quality, enchantment, race and slot, in that order.
+enum ArmorAttribute
+{
+	ATTRIBUTE_CONDITION,
+	ATTRIBUTE_QUALITY,
+	ATTRIBUTE_ENCHANTMENT,
+	ATTRIBUTE_RACE,
+	ATTRIBUTE_SLOT,
+	ATTRIBUTE_COUNT
+};
+
+
+// Code of an attribute that could not be parsed from a description.
+const uint8_t ATTRIBUTE_UNKNOWN = 255;
+
+
+// Split a description into its attribute tokens, e.g. "deteriorating", "poor quality",
+// "enchanted", "elf" and "shield". The slot is found with armor_slot(); the race and
+// enchantment are the single words before it, the condition is the first word and the
+// quality is everything in between.
+// Returns false when the description has too few words for all five attributes.
+bool parse_armor_attributes
+(
+	const std::string& description,
+	std::array<std::string, ATTRIBUTE_COUNT>& tokens
+)
+{
+	tokens[ATTRIBUTE_SLOT] = armor_slot(description);
+	if (description.size() <= tokens[ATTRIBUTE_SLOT].size()){
+		return false;
+	}
+
+	std::vector<std::string> words;
+	std::stringstream ss(description.substr(0, description.size() - tokens[ATTRIBUTE_SLOT].size()));
+	for (std::string word; ss >> word; ){
+		words.push_back(word);
+	}
+	if (words.size() < 4){
+		return false;
+	}
+
+	tokens[ATTRIBUTE_CONDITION] = words.front();
+	tokens[ATTRIBUTE_RACE] = words[words.size() - 1];
+	tokens[ATTRIBUTE_ENCHANTMENT] = words[words.size() - 2];
+	tokens[ATTRIBUTE_QUALITY] = words[1];
+	for (size_t i = 2; i + 2 < words.size(); i++){
+		tokens[ATTRIBUTE_QUALITY] += " " + words[i];
+	}
+	return true;
+}
+
+
+// Dictionary from the tokens of one attribute to one-byte codes, numbered in order of first use.
+// Lookups go through a perfect hash table: whenever a token is added, a hash seed is searched
+// for under which no two tokens share a slot, so a lookup is one hash and one string compare.
+class AttributeDictionary
+{
+	//
+	public:
+
+		//
+		AttributeDictionary()
+			:
+			_seed(0),
+			_slots(1, ATTRIBUTE_UNKNOWN)
+		{
+		}
+
+		// The code of token, or ATTRIBUTE_UNKNOWN when it is not in the dictionary.
+		uint8_t code(const std::string& token) const
+		{
+			uint8_t candidate = _slots[hash(token, _seed) & (_slots.size() - 1)];
+			if (candidate != ATTRIBUTE_UNKNOWN && _tokens[candidate] == token){
+				return candidate;
+			}
+			return ATTRIBUTE_UNKNOWN;
+		}
+
+		// The code of token, adding it to the dictionary if it is new.
+		uint8_t intern(const std::string& token)
+		{
+			uint8_t existing = code(token);
+			if (existing != ATTRIBUTE_UNKNOWN){
+				return existing;
+			}
+			assert(_tokens.size() < ATTRIBUTE_UNKNOWN);
+			_tokens.push_back(token);
+			rebuild();
+			return _tokens.size() - 1;
+		}
+
+		//
+		const std::string& token(uint8_t code) const { return _tokens.at(code); }
+		size_t size() const { return _tokens.size(); }
+
+	//
+	private:
+
+		// FNV-1a, mixed with a seed.
+		static uint64_t hash(const std::string& token, uint64_t seed)
+		{
+			uint64_t h = 14695981039346656037ull ^ (seed * 0x9e3779b97f4a7c15ull);
+			for (unsigned char c : token){
+				h = (h ^ c) * 1099511628211ull;
+			}
+			return h ^ (h >> 29);
+		}
+
+		// Find a table size and seed with no collisions among the tokens.
+		void rebuild()
+		{
+			size_t size = 1;
+			while (size < 2 * _tokens.size()){
+				size *= 2;
+			}
+			for (uint64_t seed = 0; ; seed++){
+				std::vector<uint8_t> slots(size, ATTRIBUTE_UNKNOWN);
+				bool perfect = true;
+				for (size_t i = 0; i < _tokens.size() && perfect; i++){
+					uint8_t& slot = slots[hash(_tokens[i], seed) & (size - 1)];
+					perfect = (slot == ATTRIBUTE_UNKNOWN);
+					slot = i;
+				}
+				if (perfect){
+					_seed = seed;
+					_slots.swap(slots);
+					return;
+				}
+				if (seed % 64 == 63){
+					size *= 2;
+				}
+			}
+		}
+
+		//
+		std::vector<std::string> _tokens;
+		uint64_t _seed;
+
+		// Hash table slots, holding token codes; the size is a power of two.
+		std::vector<uint8_t> _slots;
+};
+
+
+// Dictionary-encoded store of descriptions. Each distinct description gets a 32-bit id,
+// and is kept once, as a sequence of word ids into a dictionary of distinct words,
+// so a catalog with repetitive descriptions needs a few bytes per row instead of a string each.
+// Descriptions are split at single spaces, so every description round-trips exactly.
+class DescriptionPool
+{
+	//
+	public:
+
+		//
+		DescriptionPool()
+			:
+			_offsets(1, 0),
+			_slots(16, 0)
+		{
+		}
+
+		// The id of description, adding it to the pool if it is new.
+		uint32_t intern(const std::string& description)
+		{
+			const size_t start = _words_of_descriptions.size();
+			for (size_t begin = 0; ; ){
+				size_t space = description.find(' ', begin);
+				size_t end = (space == std::string::npos) ? description.size() : space;
+				_words_of_descriptions.push_back(word_id(description.substr(begin, end - begin)));
+				if (space == std::string::npos){
+					break;
+				}
+				begin = space + 1;
+			}
+
+			// Look the word sequence up; if it is already known, take it back off the end.
+			const uint64_t h = hash(&_words_of_descriptions[start], _words_of_descriptions.size() - start);
+			size_t slot = h & (_slots.size() - 1);
+			for ( ; _slots[slot] != 0; slot = (slot + 1) & (_slots.size() - 1)){
+				const uint32_t id = _slots[slot] - 1;
+				if (std::equal(
+					&_words_of_descriptions[_offsets[id]], &_words_of_descriptions[_offsets[id + 1]],
+					_words_of_descriptions.begin() + start, _words_of_descriptions.end())){
+					_words_of_descriptions.resize(start);
+					return id;
+				}
+			}
+
+			const uint32_t id = size();
+			_offsets.push_back(_words_of_descriptions.size());
+			_slots[slot] = id + 1;
+			if (2 * size() > _slots.size()){
+				grow();
+			}
+			return id;
+		}
+
+		// The description with the given id.
+		std::string description(uint32_t id) const
+		{
+			assert(id < size());
+			std::string result;
+			for (uint32_t i = _offsets[id]; i < _offsets[id + 1]; i++){
+				if (i > _offsets[id]){
+					result += ' ';
+				}
+				result += _words[_words_of_descriptions[i]];
+			}
+			return result;
+		}
+
+		// Number of distinct descriptions and of distinct words.
+		size_t size() const { return _offsets.size() - 1; }
+		size_t word_count() const { return _words.size(); }
+
+		// The word ids of the description with the given id, in order, as [first, second).
+		std::pair<const uint32_t*, const uint32_t*> words(uint32_t id) const
+		{
+			assert(id < size());
+			const uint32_t* base = _words_of_descriptions.data();
+			return std::make_pair(base + _offsets[id], base + _offsets[id + 1]);
+		}
+
+		// The word with the given word id.
+		const std::string& word(uint32_t word_id) const { return _words[word_id]; }
+
+		// Bytes allocated by the pool, approximately.
+		size_t memory_bytes() const
+		{
+			size_t bytes =
+				_words_of_descriptions.capacity() * sizeof(uint32_t)
+				+ _offsets.capacity() * sizeof(uint32_t)
+				+ _slots.capacity() * sizeof(uint32_t)
+				+ _words.capacity() * sizeof(std::string)
+				;
+			for (auto& word : _words){
+				// Words, and the word dictionary's copy of them, with its hash nodes.
+				bytes += 2 * (word.capacity() + 1) + sizeof(std::string) + 4 * sizeof(void*);
+			}
+			return bytes;
+		}
+
+	//
+	private:
+
+		//
+		uint32_t word_id(const std::string& word)
+		{
+			auto found = _word_ids.find(word);
+			if (found != _word_ids.end()){
+				return found->second;
+			}
+			_word_ids[word] = _words.size();
+			_words.push_back(word);
+			return _words.size() - 1;
+		}
+
+		//
+		static uint64_t hash(const uint32_t* words, size_t count)
+		{
+			uint64_t h = 14695981039346656037ull;
+			for (size_t i = 0; i < count; i++){
+				h = (h ^ words[i]) * 1099511628211ull;
+			}
+			return h ^ (h >> 31);
+		}
+
+		// Double the hash table and reinsert every description.
+		void grow()
+		{
+			std::vector<uint32_t> slots(_slots.size() * 2, 0);
+			for (uint32_t id = 0; id < size(); id++){
+				size_t slot = hash(&_words_of_descriptions[_offsets[id]], _offsets[id + 1] - _offsets[id]) & (slots.size() - 1);
+				while (slots[slot] != 0){
+					slot = (slot + 1) & (slots.size() - 1);
+				}
+				slots[slot] = id + 1;
+			}
+			_slots.swap(slots);
+		}
+
+		// Distinct words, and their ids.
+		std::vector<std::string> _words;
+		std::unordered_map<std::string, uint32_t> _word_ids;
+
+		// Description id i is the words _words_of_descriptions[_offsets[i] .. _offsets[i + 1]).
+		std::vector<uint32_t> _words_of_descriptions;
+		std::vector<uint32_t> _offsets;
+
+		// Open-addressing hash table from word sequences to description id + 1; 0 is empty.
+		std::vector<uint32_t> _slots;
+};
+
+
+// An armor catalog stored by column. Row r has description(r), costs()[r] and defenses()[r],
+// and, once tokenize_attributes() has run, one byte per attribute in attribute(a)[r].
+// Descriptions are kept in a DescriptionPool, and each row holds only the id of its description.
+class ArmorTable
+{
+	//
+	public:
+
+		//
+		size_t size() const { return _costs.size(); }
+		const std::vector<double>& costs() const { return _costs; }
+		const std::vector<double>& defenses() const { return _defenses; }
+		std::string description(size_t row) const { return _pool.description(_description_ids[row]); }
+		const std::vector<uint32_t>& description_ids() const { return _description_ids; }
+		const DescriptionPool& pool() const { return _pool; }
+
+		// Add a row.
+		void append(const std::string& description, double cost, double defense)
+		{
+			_description_ids.push_back(_pool.intern(description));
+			_costs.push_back(cost);
+			_defenses.push_back(defense);
+		}
+
+		// Parse the attributes of every row's description into the attribute columns.
+		// Each distinct description is parsed once. Rows whose description cannot be parsed
+		// get ATTRIBUTE_UNKNOWN in every column.
+		void tokenize_attributes()
+		{
+			std::array<std::string, ATTRIBUTE_COUNT> tokens;
+			std::vector<std::array<uint8_t, ATTRIBUTE_COUNT>> codes(_pool.size());
+			for (uint32_t id = 0; id < _pool.size(); id++){
+				bool parsed = parse_armor_attributes(_pool.description(id), tokens);
+				for (int a = 0; a < ATTRIBUTE_COUNT; a++){
+					codes[id][a] = parsed ? _dictionaries[a].intern(tokens[a]) : ATTRIBUTE_UNKNOWN;
+				}
+			}
+			for (int a = 0; a < ATTRIBUTE_COUNT; a++){
+				_attributes[a].resize(size());
+				for (size_t row = 0; row < size(); row++){
+					_attributes[a][row] = codes[_description_ids[row]][a];
+				}
+			}
+			_has_attributes = true;
+		}
+
+		//
+		bool has_attributes() const { return _has_attributes; }
+		const std::vector<uint8_t>& attribute(ArmorAttribute a) const { return _attributes[a]; }
+		const AttributeDictionary& dictionary(ArmorAttribute a) const { return _dictionaries[a]; }
+
+		// Make an ArmorItem for one row.
+		std::shared_ptr<ArmorItem> item(size_t row) const
+		{
+			return std::make_shared<ArmorItem>(description(row), _costs[row], _defenses[row]);
+		}
+
+		// Make an ArmorVector of the selected rows, to pass to the solvers.
+		std::unique_ptr<ArmorVector> items(const RowSelection& rows) const
+		{
+			std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+			result->reserve(rows.size());
+			for (uint32_t row : rows){
+				result->push_back(item(row));
+			}
+			return result;
+		}
+
+	//
+	private:
+
+		//
+		DescriptionPool _pool;
+		std::vector<uint32_t> _description_ids;
+		std::vector<double> _costs, _defenses;
+
+		//
+		bool _has_attributes = false;
+		std::array<std::vector<uint8_t>, ATTRIBUTE_COUNT> _attributes;
+		std::array<AttributeDictionary, ATTRIBUTE_COUNT> _dictionaries;
+};
+
+
+// Load the CSV database into an ArmorTable, with the same rules as load_armor_database.
+// When with_attributes is true, descriptions are also tokenized into the attribute columns.
+// Returns nullptr on I/O error.
+std::unique_ptr<ArmorTable> load_armor_table(const std::string& path, bool with_attributes)
+{
+	std::unique_ptr<ArmorVector> armors = load_armor_database(path);
+	if (!armors){
+		return nullptr;
+	}
+
+	std::unique_ptr<ArmorTable> table = std::make_unique<ArmorTable>();
+	for (auto& armor : *armors){
+		table->append(armor->description(), armor->cost(), armor->defense());
+	}
+	if (with_attributes){
+		table->tokenize_attributes();
+	}
+	return table;
+}
+
+
+// Select the rows whose attribute a is token, comparing one-byte codes instead of strings.
+// The table's attributes must have been tokenized.
+RowSelection select_attribute
+(
+	const ArmorTable& table,
+	ArmorAttribute a,
+	const std::string& token
+)
+{
+	assert(table.has_attributes());
+	RowSelection rows;
+	const uint8_t code = table.dictionary(a).code(token);
+	if (code == ATTRIBUTE_UNKNOWN){
+		return rows;
+	}
+	const std::vector<uint8_t>& column = table.attribute(a);
+	for (size_t row = 0; row < column.size(); row++){
+		if (column[row] == code){
+			rows.push_back(row);
+		}
+	}
+	return rows;
+}
+
+
+// Group the rows of the table by the code of attribute a: result[code] lists the rows with that code.
+// Rows with an unknown attribute are left out. The table's attributes must have been tokenized.
+std::vector<RowSelection> group_by_attribute
+(
+	const ArmorTable& table,
+	ArmorAttribute a
+)
+{
+	assert(table.has_attributes());
+	std::vector<RowSelection> groups(table.dictionary(a).size());
+	const std::vector<uint8_t>& column = table.attribute(a);
+	for (size_t row = 0; row < column.size(); row++){
+		if (column[row] != ATTRIBUTE_UNKNOWN){
+			groups[column[row]].push_back(row);
+		}
+	}
+	return groups;
+}
+
+
+// Append to rows the indices i in [first, count) with min_value <= column[i] <= max_value, in increasing
+// order, stopping once rows holds limit indices. NaN values never match.
+// The column is compared a block at a time without branching on the values: every index is
+// written and the output position advances only when its value matched. With AVX2 the
+// comparisons are made four doubles at a time, and the matching indices of each four are
+// compacted through a lookup table indexed by the comparison mask.
+void select_range_span
+(
+	const double* column,
+	size_t count,
+	double min_value,
+	double max_value,
+	size_t limit,
+	RowSelection& rows,
+	size_t first = 0
+)
+{
+	const size_t block = 4096;
+	size_t n = rows.size();
+	for (size_t begin = first; begin < count && n < limit; begin += block){
+		const size_t end = std::min(count, begin + block);
+		// Room for a whole block of matches, plus a little slack for the vector stores.
+		rows.resize(n + (end - begin) + 4);
+		uint32_t* out = rows.data();
+		size_t i = begin;
+#if defined(__AVX2__)
+		static const std::array<std::array<uint32_t, 4>, 16> compact = []()
+		{
+			std::array<std::array<uint32_t, 4>, 16> table{};
+			for (int mask = 0; mask < 16; mask++){
+				int k = 0;
+				for (int bit = 0; bit < 4; bit++){
+					if (mask & (1 << bit)){
+						table[mask][k++] = bit;
+					}
+				}
+			}
+			return table;
+		}();
+		const __m256d low = _mm256_set1_pd(min_value), high = _mm256_set1_pd(max_value);
+		for (; i + 4 <= end; i += 4){
+			const __m256d values = _mm256_loadu_pd(column + i);
+			const __m256d match = _mm256_and_pd(_mm256_cmp_pd(values, low, _CMP_GE_OQ), _mm256_cmp_pd(values, high, _CMP_LE_OQ));
+			const int mask = _mm256_movemask_pd(match);
+			const __m128i offsets = _mm_loadu_si128(reinterpret_cast<const __m128i*>(compact[mask].data()));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + n), _mm_add_epi32(offsets, _mm_set1_epi32(i)));
+			n += __builtin_popcount(mask);
+		}
+#endif
+		for (; i < end; i++){
+			out[n] = i;
+			n += (column[i] >= min_value) & (column[i] <= max_value);
+		}
+	}
+	rows.resize(std::min(n, limit));
+}
+
+
+// Select the first total_size rows of the table whose defense is between min_defense and
+// max_defense (inclusive), i.e. the rows filter_armor_vector would keep, as a selection vector.
+// As with filter_armor_vector, a total_size of 0 keeps one row and a negative one keeps all;
+// see filter_size_limit.
+RowSelection select_defense_range
+(
+	const ArmorTable& table,
+	double min_defense,
+	double max_defense,
+	int total_size
+)
+{
+	RowSelection rows;
+	select_range_span(table.defenses().data(), table.size(), min_defense, max_defense, filter_size_limit(total_size), rows);
+	return rows;
+}
+
+
+// Secondary index over one numeric column of an ArmorTable, e.g. defenses() or costs():
+// the row ids sorted by value, ties by row, next to the sorted values themselves.
+// Range queries binary-search the values, so they take O(log n + k) for k matching rows.
+// NaN values are left out, since no range matches them.
+class ColumnIndex
+{
+	//
+	public:
+
+		//
+		explicit ColumnIndex(const std::vector<double>& column)
+		{
+			// Sorting (value, row) pairs keeps the comparisons in cache, unlike sorting row ids by column[row].
+			std::vector<std::pair<double, uint32_t>> entries;
+			for (size_t row = 0; row < column.size(); row++){
+				if (!std::isnan(column[row])){
+					entries.push_back(std::make_pair(column[row], row));
+				}
+			}
+			std::sort(entries.begin(), entries.end());
+			_rows.reserve(entries.size());
+			_values.reserve(entries.size());
+			for (auto& entry : entries){
+				_values.push_back(entry.first);
+				_rows.push_back(entry.second);
+			}
+		}
+
+		//
+		size_t size() const { return _rows.size(); }
+
+		// The rows with min_value <= value <= max_value, in order of value.
+		RowSelection range(double min_value, double max_value) const
+		{
+			auto span = find(min_value, max_value);
+			return RowSelection(_rows.begin() + span.first, _rows.begin() + span.second);
+		}
+
+		// The first limit rows, in row order, with min_value <= value <= max_value, i.e. what a
+		// scan of the column would select. The smallest limit of the k matching row ids are
+		// picked with nth_element and then sorted, in O(log n + k + limit log limit).
+		RowSelection first_rows(double min_value, double max_value, size_t limit) const
+		{
+			RowSelection rows = range(min_value, max_value);
+			if (limit < rows.size()){
+				std::nth_element(rows.begin(), rows.begin() + limit, rows.end());
+				rows.resize(limit);
+			}
+			std::sort(rows.begin(), rows.end());
+			return rows;
+		}
+
+	//
+	private:
+
+		// Positions [first, second) of the values in range.
+		std::pair<size_t, size_t> find(double min_value, double max_value) const
+		{
+			if (!(min_value <= max_value)){
+				return std::make_pair(0, 0);
+			}
+			size_t begin = std::lower_bound(_values.begin(), _values.end(), min_value) - _values.begin();
+			size_t end = std::upper_bound(_values.begin(), _values.end(), max_value) - _values.begin();
+			return std::make_pair(begin, end);
+		}
+
+		//
+		std::vector<uint32_t> _rows;
+		std::vector<double> _values;
+};
+
+
+// The rows in both a and b, and the rows in either, for composing selections.
+RowSelection intersect_rows(const RowSelection& a, const RowSelection& b)
+{
+	RowSelection rows;
+	std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(rows));
+	return rows;
+}
+RowSelection union_rows(const RowSelection& a, const RowSelection& b)
+{
+	RowSelection rows;
+	std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(rows));
+	return rows;
+}
+
+
+// Narrow a selection to the first limit of its rows with min_value <= column[row] <= max_value,
+// e.g. to apply a defense range to the rows of a TokenIndex query.
+RowSelection select_range_rows
+(
+	const std::vector<double>& column,
+	const RowSelection& rows,
+	double min_value,
+	double max_value,
+	size_t limit
+)
+{
+	RowSelection result;
+	for (uint32_t row : rows){
+		if (result.size() >= limit){
+			break;
+		}
+		if (column[row] >= min_value && column[row] <= max_value){
+			result.push_back(row);
+		}
+	}
+	return result;
+}
+
+
+// Inverted index from the words of an ArmorTable's descriptions to the rows whose description
+// contains them. Each word's posting list holds its rows in increasing order, stored as the
+// gaps between consecutive rows in a variable-length byte encoding (7 bits per byte, high bit
+// set on all but the last byte), so the common small gaps take one byte.
+// Descriptions are split into words as in DescriptionPool, so "chest plate" is two words.
+class TokenIndex
+{
+	//
+	public:
+
+		// Index every row of the table.
+		explicit TokenIndex(const ArmorTable& table)
+			:
+			_postings(table.pool().word_count())
+		{
+			// The distinct words of each distinct description.
+			std::vector<std::vector<uint32_t>> words_of(table.pool().size());
+			for (uint32_t id = 0; id < words_of.size(); id++){
+				auto words = table.pool().words(id);
+				words_of[id].assign(words.first, words.second);
+				std::sort(words_of[id].begin(), words_of[id].end());
+				words_of[id].erase(std::unique(words_of[id].begin(), words_of[id].end()), words_of[id].end());
+			}
+			for (uint32_t row = 0; row < table.size(); row++){
+				for (uint32_t word : words_of[table.description_ids()[row]]){
+					_postings[word].append(row);
+				}
+			}
+			for (uint32_t word = 0; word < _postings.size(); word++){
+				_word_ids[table.pool().word(word)] = word;
+			}
+		}
+
+		// The rows whose description contains word.
+		RowSelection rows(const std::string& word) const
+		{
+			auto found = _word_ids.find(word);
+			return (found == _word_ids.end()) ? RowSelection() : _postings[found->second].decode();
+		}
+
+		// The rows whose description contains every one of words, or any of them.
+		// An intersection starts from the shortest posting list.
+		RowSelection all_of(const std::vector<std::string>& words) const
+		{
+			std::vector<RowSelection> lists;
+			for (auto& word : words){
+				lists.push_back(rows(word));
+			}
+			if (lists.empty()){
+				return RowSelection();
+			}
+			std::sort(lists.begin(), lists.end(), [](const RowSelection& a, const RowSelection& b) { return a.size() < b.size(); });
+			RowSelection result = lists[0];
+			for (size_t i = 1; i < lists.size() && !result.empty(); i++){
+				result = intersect_rows(result, lists[i]);
+			}
+			return result;
+		}
+		RowSelection any_of(const std::vector<std::string>& words) const
+		{
+			RowSelection result;
+			for (auto& word : words){
+				result = union_rows(result, rows(word));
+			}
+			return result;
+		}
+
+		// Bytes allocated by the posting lists.
+		size_t memory_bytes() const
+		{
+			size_t bytes = _postings.capacity() * sizeof(PostingList);
+			for (auto& posting : _postings){
+				bytes += posting.bytes.capacity();
+			}
+			return bytes;
+		}
+
+	//
+	private:
+
+		//
+		struct PostingList
+		{
+			std::vector<uint8_t> bytes;
+			uint32_t count = 0, last = 0;
+
+			// Add a row, greater than every row added so far.
+			void append(uint32_t row)
+			{
+				uint32_t gap = (count == 0) ? row : row - last;
+				while (gap >= 0x80){
+					bytes.push_back(0x80 | (gap & 0x7f));
+					gap >>= 7;
+				}
+				bytes.push_back(gap);
+				last = row;
+				count++;
+			}
+
+			//
+			RowSelection decode() const
+			{
+				RowSelection rows;
+				rows.reserve(count);
+				uint32_t row = 0;
+				for (size_t i = 0; i < bytes.size(); ){
+					uint32_t gap = 0;
+					for (int shift = 0; ; shift += 7){
+						const uint8_t byte = bytes[i++];
+						gap |= uint32_t(byte & 0x7f) << shift;
+						if (!(byte & 0x80)){
+							break;
+						}
+					}
+					row += gap;
+					rows.push_back(row);
+				}
+				return rows;
+			}
+		};
+
+		//
+		std::vector<PostingList> _postings;
+		std::unordered_map<std::string, uint32_t> _word_ids;
+};
+
+
+// Per-block statistics of one numeric column of an ArmorTable: the minimum and maximum value
+// of each block of BLOCK_ROWS consecutive rows, ignoring NaN, and whether the block has any NaN.
+// A range scan can skip the blocks whose [minimum, maximum] misses the range, and take every row
+// of the blocks that lie inside it without comparing them. How many blocks get skipped depends
+// on how clustered the column is: all but a few when the rows are sorted by it, and almost none
+// when its values are spread uniformly.
+class ZoneMap
+{
+	//
+	public:
+
+		//
+		static constexpr size_t BLOCK_ROWS = 4096;
+
+		//
+		explicit ZoneMap(const std::vector<double>& column)
+			:
+			_rows(column.size())
+		{
+			for (size_t begin = 0; begin < column.size(); begin += BLOCK_ROWS){
+				double low = std::numeric_limits<double>::infinity(), high = -low;
+				bool nan = false;
+				for (size_t row = begin; row < std::min(column.size(), begin + BLOCK_ROWS); row++){
+					// fmin and fmax ignore NaN.
+					low = std::fmin(low, column[row]);
+					high = std::fmax(high, column[row]);
+					nan = nan || std::isnan(column[row]);
+				}
+				_mins.push_back(low);
+				_maxs.push_back(high);
+				_has_nan.push_back(nan);
+			}
+		}
+
+		//
+		size_t rows() const { return _rows; }
+		size_t blocks() const { return _mins.size(); }
+		double min(size_t block) const { return _mins[block]; }
+		double max(size_t block) const { return _maxs[block]; }
+		bool has_nan(size_t block) const { return _has_nan[block]; }
+
+	//
+	private:
+
+		//
+		size_t _rows;
+		std::vector<double> _mins, _maxs;
+		std::vector<bool> _has_nan;
+};
+
+
+// Select the first limit rows with min_value <= column[row] <= max_value, in row order, like
+// select_range_span, using the zone map of the column to skip the blocks that cannot match.
+// blocks_skipped is set to the number of blocks never read.
+RowSelection select_range_zoned
+(
+	const std::vector<double>& column,
+	const ZoneMap& zones,
+	double min_value,
+	double max_value,
+	size_t limit,
+	size_t& blocks_skipped
+)
+{
+	assert(zones.rows() == column.size());
+	RowSelection rows;
+	blocks_skipped = 0;
+	for (size_t block = 0; block < zones.blocks(); block++){
+		const size_t begin = block * ZoneMap::BLOCK_ROWS, end = std::min(column.size(), begin + ZoneMap::BLOCK_ROWS);
+		if (rows.size() >= limit || zones.max(block) < min_value || zones.min(block) > max_value){
+			blocks_skipped++;
+		}
+		else if (zones.min(block) >= min_value && zones.max(block) <= max_value && !zones.has_nan(block)){
+			// Every row matches.
+			const size_t n = rows.size(), take = std::min(end - begin, limit - n);
+			rows.resize(n + take);
+			std::iota(rows.begin() + n, rows.end(), begin);
+		}
+		else {
+			select_range_span(column.data(), end, min_value, max_value, limit, rows, begin);
+		}
+	}
+	return rows;
+}
+
+
+// Compute greedy_max_defense(*filter_armor_vector(armors, min_defense, max_defense, total_size), total_cost)
+// in one pass over the table's columns, returning the rows chosen, in the order greedy_max_defense
+// chooses them, to be materialized with ArmorTable::items().
+// The scan keeps the first total_size rows in the defense range, as filter_armor_vector does,
+// including its handling of a total_size of 0 or less (see filter_size_limit), but
+// only pushes their defense per gold and row onto a max-heap; no filtered vector is built.
+// Items are then popped in decreasing ratio, earlier rows first on ties, and taken when they fit.
+// Popping stops as soon as the gold left is less than the cheapest candidate's cost.
+RowSelection greedy_max_defense_fused
+(
+	const ArmorTable& table,
+	double min_defense,
+	double max_defense,
+	int total_size,
+	double total_cost
+)
+{
+	const std::vector<double>& costs = table.costs();
+	const std::vector<double>& defenses = table.defenses();
+
+	// Greater ratio first, then smaller row.
+	typedef std::pair<double, uint32_t> Candidate;
+	auto lower = [](const Candidate& a, const Candidate& b)
+	{
+		return a.first < b.first || (a.first == b.first && a.second > b.second);
+	};
+	std::vector<Candidate> heap;
+	double cheapest = std::numeric_limits<double>::infinity();
+	size_t matched = 0;
+	const size_t limit = filter_size_limit(total_size);
+	for (size_t row = 0; row < table.size() && matched < limit; row++){
+		if (defenses[row] >= min_defense && defenses[row] <= max_defense){
+			matched++;
+			const double ratio = defenses[row] / costs[row];
+			if (ratio > 0.0 && costs[row] <= total_cost){
+				heap.push_back(std::make_pair(ratio, row));
+				std::push_heap(heap.begin(), heap.end(), lower);
+				cheapest = std::min(cheapest, costs[row]);
+			}
+		}
+	}
+
+	RowSelection rows;
+	double result_cost = 0.0;
+	while (!heap.empty() && result_cost + cheapest <= total_cost){
+		std::pop_heap(heap.begin(), heap.end(), lower);
+		const uint32_t row = heap.back().second;
+		heap.pop_back();
+		if ((result_cost + costs[row]) <= total_cost){
+			rows.push_back(row);
+			result_cost += costs[row];
+		}
+	}
+	return rows;
+}
+
+
+// Select the first limit rows with min_value <= column[row] <= max_value, in row order, like
+// select_range_span, with the given number of threads.
+// The column is split into chunks, handled in waves of one chunk per thread. In each wave every
+// thread selects the matches of its chunk into a buffer of its own; then the counts are summed
+// into each chunk's offset in the result, and every thread copies its matches into place.
+// Waves stop as soon as limit rows are found, so the chunks past that point are never read.
+RowSelection select_range_parallel
+(
+	const std::vector<double>& column,
+	double min_value,
+	double max_value,
+	size_t limit,
+	size_t threads
+)
+{
+	assert(threads > 0);
+	const size_t chunk_rows = 65536;
+
+	RowSelection rows;
+	std::vector<RowSelection> matches(threads);
+	std::vector<size_t> offsets(threads);
+	size_t wave_begin = 0;
+	bool done = column.empty() || limit == 0;
+	ThreadBarrier barrier(threads);
+
+	auto worker = [&](size_t t)
+	{
+		while (!done){
+			const size_t begin = wave_begin + t * chunk_rows;
+			matches[t].clear();
+			if (begin < column.size()){
+				select_range_span(column.data(), std::min(column.size(), begin + chunk_rows), min_value, max_value, SIZE_MAX, matches[t], begin);
+			}
+			barrier.wait();
+
+			if (t == 0){
+				size_t n = rows.size();
+				for (size_t k = 0; k < threads; k++){
+					offsets[k] = n;
+					n += matches[k].size();
+				}
+				rows.resize(std::min(n, limit));
+				wave_begin += threads * chunk_rows;
+				done = (rows.size() >= limit || wave_begin >= column.size());
+			}
+			barrier.wait();
+
+			if (offsets[t] < rows.size()){
+				const size_t count = std::min(matches[t].size(), rows.size() - offsets[t]);
+				std::copy(matches[t].begin(), matches[t].begin() + count, rows.begin() + offsets[t]);
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t t = 1; t < threads; t++){
+		pool.push_back(std::thread(worker, t));
+	}
+	worker(0);
+	for (auto& thread : pool){
+		thread.join();
+	}
+	return rows;
+}
+
+
+// The defense per gold of every row of the table, as a key column for top_k_rows.
+std::vector<double> ratio_keys(const ArmorTable& table)
+{
+	std::vector<double> keys(table.size());
+	const double* costs = table.costs().data();
+	const double* defenses = table.defenses().data();
+	for (size_t row = 0; row < keys.size(); row++){
+		keys[row] = defenses[row] / costs[row];
+	}
+	return keys;
+}
+
+
+// The k rows with the greatest keys, e.g. a column of the table or ratio_keys(table), in order of
+// decreasing key, earlier rows first on ties. NaN keys are never selected.
+// For instance, table.items(top_k_rows(ratio_keys(table), 40)) gives the 40 best-ratio items to
+// pass to an exact solver such as branch_bound_max_defense.
+// Each of the threads keeps a bounded heap of its best k rows over its share of the keys, and
+// only looks at a block of keys after selecting, with the vectorized range kernel, those that
+// are at least the worst key in its heap. The threads' heaps are merged at the end.
+RowSelection top_k_rows
+(
+	const std::vector<double>& keys,
+	size_t k,
+	size_t threads = 1
+)
+{
+	assert(threads > 0);
+	typedef std::pair<double, uint32_t> Entry;
+	auto better = [](const Entry& a, const Entry& b)
+	{
+		return a.first > b.first || (a.first == b.first && a.second < b.second);
+	};
+
+	// Heaps with their worst entry on top.
+	std::vector<std::vector<Entry>> heaps(threads);
+	auto worker = [&](size_t t)
+	{
+		const size_t block = 4096;
+		const size_t begin = keys.size() * t / threads, end = keys.size() * (t + 1) / threads;
+		std::vector<Entry>& heap = heaps[t];
+		RowSelection candidates;
+		for (size_t first = begin; first < end && k > 0; first += block){
+			const double threshold = (heap.size() < k) ? -std::numeric_limits<double>::infinity() : heap.front().first;
+			candidates.clear();
+			select_range_span(keys.data(), std::min(end, first + block), threshold, std::numeric_limits<double>::infinity(), SIZE_MAX, candidates, first);
+			for (uint32_t row : candidates){
+				const Entry entry(keys[row], row);
+				if (heap.size() < k){
+					heap.push_back(entry);
+					std::push_heap(heap.begin(), heap.end(), better);
+				}
+				else if (better(entry, heap.front())){
+					std::pop_heap(heap.begin(), heap.end(), better);
+					heap.back() = entry;
+					std::push_heap(heap.begin(), heap.end(), better);
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t t = 1; t < threads; t++){
+		pool.push_back(std::thread(worker, t));
+	}
+	worker(0);
+	for (auto& thread : pool){
+		thread.join();
+	}
+
+	std::vector<Entry> entries;
+	for (auto& heap : heaps){
+		entries.insert(entries.end(), heap.begin(), heap.end());
+	}
+	if (entries.size() > k){
+		std::nth_element(entries.begin(), entries.begin() + k, entries.end(), better);
+		entries.resize(k);
+	}
+	std::sort(entries.begin(), entries.end(), better);
+
+	RowSelection rows;
+	for (auto& entry : entries){
+		rows.push_back(entry.second);
+	}
+	return rows;
+}
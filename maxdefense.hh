@@ -10,14 +10,29 @@
 #pragma once
 
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include "timer.hh"
 
@@ -29,16 +44,16 @@ class ArmorItem
 		//
 		ArmorItem
 		(
-			const std::string& description,
+			std::string description,
 			double cost_gold,
 			double defense_points
 		)
 			:
-			_description(description),
+			_description(std::move(description)),
 			_cost_gold(cost_gold),
 			_defense_points(defense_points)
 		{
-			assert(!description.empty());
+			assert(!_description.empty());
 			assert(cost_gold > 0);
 		}
 
@@ -65,10 +80,78 @@ class ArmorItem
 typedef std::vector<std::shared_ptr<ArmorItem>> ArmorVector;
 
 
+// A conjunction of predicates on armor items: a cost range, a defense range, a minimum
+// defense-per-gold ratio and keywords that must all occur in the description, plus a limit
+// on the number of matching items. Every predicate is unconstrained until set, and the
+// setters return the query so that they can be chained, e.g.
+//	ArmorQuery().cost_range(0, 20).min_ratio(1.5).keyword("shield").limit(10)
+class ArmorQuery
+{
+	//
+	public:
+
+		//
+		ArmorQuery& cost_range(double min_cost, double max_cost) { _min_cost = min_cost; _max_cost = max_cost; return *this; }
+		ArmorQuery& defense_range(double min_defense, double max_defense) { _min_defense = min_defense; _max_defense = max_defense; return *this; }
+		ArmorQuery& min_ratio(double ratio) { _min_ratio = ratio; return *this; }
+		ArmorQuery& keyword(const std::string& word) { _keywords.push_back(word); return *this; }
+		ArmorQuery& limit(size_t count) { _limit = count; return *this; }
+
+		//
+		size_t limit() const { return _limit; }
+
+		// The numeric predicates, which need no description.
+		bool numeric_match(double cost, double defense) const
+		{
+			return cost >= _min_cost && cost <= _max_cost
+				&& defense >= _min_defense && defense <= _max_defense
+				&& defense / cost >= _min_ratio;
+		}
+
+		// The keyword predicate.
+		bool keyword_match(const std::string& description) const
+		{
+			for (auto& word : _keywords){
+				if (description.find(word) == std::string::npos){
+					return false;
+				}
+			}
+			return true;
+		}
+
+		//
+		bool matches(const ArmorItem& armor) const
+		{
+			return numeric_match(armor.cost(), armor.defense()) && keyword_match(armor.description());
+		}
+
+	//
+	private:
+
+		//
+		double _min_cost = -std::numeric_limits<double>::infinity(), _max_cost = std::numeric_limits<double>::infinity();
+		double _min_defense = -std::numeric_limits<double>::infinity(), _max_defense = std::numeric_limits<double>::infinity();
+		double _min_ratio = -std::numeric_limits<double>::infinity();
+		std::vector<std::string> _keywords;
+		size_t _limit = std::numeric_limits<size_t>::max();
+};
+
+
+// The most items filter_armor_vector keeps for a given total_size. It checks the size of its
+// result against total_size after each push, as an unsigned comparison, so a total_size of 0
+// still keeps the first match, and a negative total_size keeps every match.
+size_t filter_size_limit(int total_size)
+{
+	return (total_size < 0) ? std::numeric_limits<size_t>::max() : std::max(total_size, 1);
+}
+
+
 // Load all the valid armor items from the CSV database
 // Armor items that are missing fields, or have invalid values, are skipped.
+// Only the items that match query are loaded, and reading stops at the query's limit.
+// Rows that fail its numeric predicates are skipped before their description is even copied.
 // Returns nullptr on I/O error.
-std::unique_ptr<ArmorVector> load_armor_database(const std::string& path)
+std::unique_ptr<ArmorVector> load_armor_database(const std::string& path, const ArmorQuery& query = ArmorQuery())
 {
 	std::unique_ptr<ArmorVector> failure(nullptr);
 
@@ -82,7 +165,7 @@ std::unique_ptr<ArmorVector> load_armor_database(const std::string& path)
 	std::unique_ptr<ArmorVector> result(new ArmorVector);
 
 	size_t line_number = 0;
-	for (std::string line; std::getline(f, line); )
+	for (std::string line; result->size() < query.limit() && std::getline(f, line); )
 	{
 		line_number++;
 
@@ -128,13 +211,15 @@ std::unique_ptr<ArmorVector> load_armor_database(const std::string& path)
 			return true;
 		};
 
-		std::string description(descr_field);
 		double cost_gold, defense_points;
 		if (
 			parse_dbl(cost_gold_field, cost_gold)
 			&& parse_dbl(defense_points_field, defense_points)
+			&& query.numeric_match(cost_gold, defense_points)
+			&& query.keyword_match(descr_field)
 		)
 		{
+			std::string description(descr_field);
 			result->push_back(
 				std::shared_ptr<ArmorItem>(
 					new ArmorItem(
@@ -153,6 +238,165 @@ std::unique_ptr<ArmorVector> load_armor_database(const std::string& path)
 }
 
 
+// Bump allocator that owns the ArmorItems of one loaded database.
+// Items are constructed back to back in large blocks, and all of them are destroyed and
+// freed at once with the arena, instead of one allocation and one free per item.
+class ArmorArena
+{
+	//
+	public:
+
+		//
+		explicit ArmorArena(size_t items_per_block = 4096)
+			:
+			_items_per_block(items_per_block),
+			_size(0)
+		{
+			assert(items_per_block > 0);
+		}
+
+		//
+		ArmorArena(const ArmorArena&) = delete;
+		ArmorArena& operator=(const ArmorArena&) = delete;
+
+		//
+		~ArmorArena()
+		{
+			for (size_t i = 0; i < _size; i++){
+				item(i)->~ArmorItem();
+			}
+		}
+
+		// Construct an item in the arena. It lives as long as the arena.
+		ArmorItem* make_item(std::string description, double cost_gold, double defense_points)
+		{
+			if (_size == _blocks.size() * _items_per_block){
+				_blocks.emplace_back(new unsigned char[_items_per_block * sizeof(ArmorItem)]);
+			}
+			ArmorItem* result = new (item(_size)) ArmorItem(std::move(description), cost_gold, defense_points);
+			_size++;
+			return result;
+		}
+
+		//
+		size_t size() const { return _size; }
+
+	//
+	private:
+
+		// Address of the i-th item slot.
+		ArmorItem* item(size_t i)
+		{
+			return reinterpret_cast<ArmorItem*>(_blocks[i / _items_per_block].get() + (i % _items_per_block) * sizeof(ArmorItem));
+		}
+
+		//
+		size_t _items_per_block, _size;
+		std::vector<std::unique_ptr<unsigned char[]>> _blocks;
+};
+
+
+// Load all the valid armor items from the CSV database, like load_armor_database,
+// but with the items owned by one ArmorArena.
+// Every shared_ptr in the result shares ownership of the arena, so there is no control
+// block per item, and the arena is freed in bulk when the last of them is gone.
+// Rows are split in place in a reused line buffer, so the only allocation per row
+// is the description string itself.
+// As with load_armor_database, only the items that match query are loaded.
+// Returns nullptr on I/O error.
+std::unique_ptr<ArmorVector> load_armor_database_arena(const std::string& path, const ArmorQuery& query = ArmorQuery())
+{
+	std::unique_ptr<ArmorVector> failure(nullptr);
+
+	std::ifstream f(path);
+	if (!f)
+	{
+		std::cout << "Failed to load armor database; Cannot open file: " << path << std::endl;
+		return failure;
+	}
+
+	std::shared_ptr<ArmorArena> arena = std::make_shared<ArmorArena>();
+	std::unique_ptr<ArmorVector> result(new ArmorVector);
+
+	size_t line_number = 0;
+	for (std::string line; result->size() < query.limit() && std::getline(f, line); )
+	{
+		line_number++;
+
+		// First line is a header row
+		if ( line_number == 1 )
+		{
+			continue;
+		}
+
+		// Field boundaries, split the same way as load_armor_database does:
+		// a trailing '^' does not start another field.
+		// strtod stops at the '^' that ends a numeric field.
+		size_t starts[3], ends[3], field_count = 0;
+		for (size_t begin = 0; begin < line.size(); )
+		{
+			size_t caret = line.find('^', begin);
+			size_t end = (caret == std::string::npos) ? line.size() : caret;
+			if (field_count < 3)
+			{
+				starts[field_count] = begin;
+				ends[field_count] = end;
+			}
+			field_count++;
+			begin = (caret == std::string::npos) ? line.size() : caret + 1;
+		}
+
+		if (field_count != 3)
+		{
+			std::cout
+				<< "Failed to load armor database: Invalid field count at line " << line_number << "; Want 3 but got " << field_count << std::endl
+				<< "Line: " << line << std::endl
+				;
+			return failure;
+		}
+
+		double cost_gold = std::strtod(line.c_str() + starts[1], nullptr);
+		double defense_points = std::strtod(line.c_str() + starts[2], nullptr);
+
+		if (!query.numeric_match(cost_gold, defense_points))
+		{
+			continue;
+		}
+
+		std::string description = line.substr(starts[0], ends[0] - starts[0]);
+		if (!query.keyword_match(description))
+		{
+			continue;
+		}
+
+		ArmorItem* armor = arena->make_item(std::move(description), cost_gold, defense_points);
+		result->push_back(std::shared_ptr<ArmorItem>(arena, armor));
+	}
+
+	f.close();
+
+	return result;
+}
+
+
+// Load the armor items of the CSV database that filter_armor_vector would keep, i.e. the first
+// total_size items whose defense is between min_defense and max_defense (inclusive),
+// checking each row as it is parsed and reading only as much of the file as it takes to find them.
+// As with filter_armor_vector, a total_size of 0 keeps one item and a negative one keeps all;
+// see filter_size_limit.
+// Returns nullptr on I/O error.
+std::unique_ptr<ArmorVector> load_filtered_armor_database
+(
+	const std::string& path,
+	double min_defense,
+	double max_defense,
+	int total_size
+)
+{
+	return load_armor_database_arena(path, ArmorQuery().defense_range(min_defense, max_defense).limit(filter_size_limit(total_size)));
+}
+
+
 // Convenience function to compute the total cost and defense in an ArmorVector.
 // Provide the ArmorVector as the first argument
 // The next two arguments will return the cost and defense back to the caller.
@@ -240,6 +484,129 @@ std::unique_ptr<ArmorVector> filter_armor_vector
 }
 
 
+// Filter a vector of armor items by an ArmorQuery.
+// The result is the first query.limit() items of source that match every predicate, in order.
+std::unique_ptr<ArmorVector> query_armor_vector
+(
+	const ArmorVector& source,
+	const ArmorQuery& query
+)
+{
+	std::unique_ptr<ArmorVector> filtered = std::make_unique<ArmorVector>();
+
+	for(auto& armor : source){
+		if (filtered->size() >= query.limit()){
+			break;
+		}
+		if (query.matches(*armor)){
+			filtered->push_back(armor);
+		}
+	}
+
+	return filtered;
+}
+
+
+// A lazy view of the items of a range of armor items, i.e. an ArmorVector or another view,
+// that match an ArmorQuery. Iterating it walks the underlying range and yields the matching
+// items, up to the query's limit, without building an ArmorVector or copying shared_ptrs.
+// Views chain, e.g. filter_view(filter_view(armors, cheap), strong), and the *_view solvers
+// take any of them. The ArmorVector at the bottom of the chain must outlive the view.
+template <typename Range>
+class ArmorFilterView
+{
+	//
+	public:
+
+		//
+		class const_iterator
+		{
+			//
+			public:
+
+				//
+				typedef std::forward_iterator_tag iterator_category;
+				typedef std::shared_ptr<ArmorItem> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const value_type* pointer;
+				typedef const value_type& reference;
+
+				//
+				const_iterator(typename Range::const_iterator it, typename Range::const_iterator end, const ArmorQuery* query)
+					:
+					_it(it),
+					_end(end),
+					_query(query),
+					_taken(0)
+				{
+					skip();
+				}
+
+				//
+				reference operator*() const { return *_it; }
+				pointer operator->() const { return &*_it; }
+				const_iterator& operator++()
+				{
+					++_it;
+					_taken++;
+					skip();
+					return *this;
+				}
+				const_iterator operator++(int) { const_iterator old = *this; ++*this; return old; }
+				bool operator==(const const_iterator& other) const { return _it == other._it; }
+				bool operator!=(const const_iterator& other) const { return _it != other._it; }
+
+			//
+			private:
+
+				// Move to the next matching item, or to the end once the limit is reached.
+				void skip()
+				{
+					if (_taken >= _query->limit()){
+						_it = _end;
+						return;
+					}
+					while (_it != _end && !_query->matches(**_it)){
+						++_it;
+					}
+				}
+
+				//
+				typename Range::const_iterator _it, _end;
+				const ArmorQuery* _query;
+				size_t _taken;
+		};
+
+		//
+		ArmorFilterView(const Range& source, const ArmorQuery& query)
+			:
+			_source(source),
+			_query(query)
+		{
+		}
+
+		//
+		const_iterator begin() const { return const_iterator(_source.begin(), _source.end(), &_query); }
+		const_iterator end() const { return const_iterator(_source.end(), _source.end(), &_query); }
+
+	//
+	private:
+
+		// An ArmorVector is referred to; a view below this one is small, and kept by value,
+		// so that a chain can be built from temporaries.
+		typename std::conditional<std::is_same<Range, ArmorVector>::value, const Range&, const Range>::type _source;
+		ArmorQuery _query;
+};
+
+
+// A lazy view of the items of source that match query. See ArmorFilterView.
+template <typename Range>
+ArmorFilterView<Range> filter_view(const Range& source, const ArmorQuery& query)
+{
+	return ArmorFilterView<Range>(source, query);
+}
+
+
 // Compute the optimal set of armor items with a greedy algorithm.
 // Specifically, among the armor items that fit within a total_cost gold budget,
 // choose the armors whose defense is greatest.
@@ -324,3 +691,1600 @@ std::unique_ptr<ArmorVector> exhaustive_max_defense
 	}
 	return bestVector;
 }
+
+
+// Compute the same set of armor items as greedy_max_defense, from any range of armor items,
+// e.g. an ArmorFilterView, without copying it into an ArmorVector first.
+// greedy_max_defense repeatedly takes the item of greatest positive defense per gold that still fits,
+// the first one on ties. As the gold left only shrinks, an item that does not fit never fits later,
+// so this is the same as one pass over the items stably sorted by decreasing ratio, taking each one
+// that fits.
+template <typename Range>
+std::unique_ptr<ArmorVector> greedy_max_defense_view
+(
+	const Range& armors,
+	double total_cost
+)
+{
+	std::vector<std::pair<double, const std::shared_ptr<ArmorItem>*>> order;
+	for (auto& armor : armors){
+		double armor_value = armor->defense() / armor->cost();
+		if (armor_value > 0.0){
+			order.push_back(std::make_pair(armor_value, &armor));
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	double result_cost = 0.0;
+	for (auto& entry : order){
+		const std::shared_ptr<ArmorItem>& armor = *entry.second;
+		if ((result_cost + armor->cost()) <= total_cost){
+			result->push_back(armor);
+			result_cost += armor->cost();
+		}
+	}
+	return result;
+}
+
+
+// Compute the same set of armor items as exhaustive_max_defense, from any range of fewer
+// than 64 armor items, e.g. an ArmorFilterView, without copying it into an ArmorVector first.
+// Subsets are enumerated as bit masks and summed in place, instead of building each candidate.
+template <typename Range>
+std::unique_ptr<ArmorVector> exhaustive_max_defense_view
+(
+	const Range& armors,
+	double total_cost
+)
+{
+	std::array<const std::shared_ptr<ArmorItem>*, 63> items;
+	int n = 0;
+	for (auto& armor : armors){
+		assert(n < 63);
+		items[n++] = &armor;
+	}
+
+	uint64_t best_bits = 0;
+	double best_defense = 0.0;
+	bool flag = false;
+	for (uint64_t bits = 0; bits < (uint64_t(1) << n); bits++){
+		double cost = 0.0, defense = 0.0;
+		for (int j = 0; j < n; j++){
+			if ((bits >> j) & 1){
+				cost += (*items[j])->cost();
+				defense += (*items[j])->defense();
+			}
+		}
+		if (cost <= total_cost && (!flag || defense > best_defense)){
+			best_defense = defense;
+			best_bits = bits;
+			flag = true;
+		}
+	}
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (int j = 0; j < n; j++){
+		if ((best_bits >> j) & 1){
+			result->push_back(*items[j]);
+		}
+	}
+	return result;
+}
+
+
+// Convert an item cost in gold to a whole number of cents (hundredths of a gold piece),
+// rounding up, so that a set of items that fits a budget in cents also fits it in gold.
+// A cost within 1e-6 cents above a whole cent counts as that cent, to absorb the rounding
+// error of gold * 100. Prices in armor.csv have two decimal places, so for them this is exact;
+// the cents-based solvers below are exact for such costs, and for costs with fractions of a cent
+// they still never exceed the budget, but may miss a set that fits only by that fraction.
+int64_t gold_to_cents(double gold)
+{
+	return int64_t(std::ceil(gold * 100.0 - 1e-6));
+}
+
+
+// Convert a gold budget to cents, rounding down so that a subset whose cost fits
+// in the cents budget also fits in the gold budget.
+int64_t budget_to_cents(double total_cost)
+{
+	return int64_t(std::floor(total_cost * 100.0 + 1e-6));
+}
+
+
+// Build the ArmorVector holding the armors[j] whose bit j is set in mask, in index order.
+std::unique_ptr<ArmorVector> armor_vector_from_mask
+(
+	const ArmorVector& armors,
+	uint64_t mask
+)
+{
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (size_t j = 0; j < armors.size(); j++){
+		if ((mask >> j) & 1){
+			result->push_back(armors[j]);
+		}
+	}
+	return result;
+}
+
+
+// One point on the cost/defense Pareto frontier of an armor vector:
+// the subset given by mask costs cost_cents and has the given total defense,
+// and no other subset is both cheaper (or equal) and at least as strong.
+struct FrontierPoint
+{
+	int64_t cost_cents;
+	double defense;
+	uint64_t mask;
+};
+
+
+// A Pareto frontier, sorted by increasing cost; defense is strictly increasing too.
+typedef std::vector<FrontierPoint> DefenseFrontier;
+
+
+// Extend a frontier with one more armor item, stored at bit index in the masks.
+// Every subset either skips the new item or takes it, so the new frontier is the
+// merge of the old frontier with a copy shifted by the item, minus dominated points.
+// Runs in time linear in the size of the frontier.
+void extend_defense_frontier
+(
+	DefenseFrontier& frontier,
+	const ArmorItem& armor,
+	int index
+)
+{
+	assert(index < 64);
+	const int64_t armor_cents = gold_to_cents(armor.cost());
+	const uint64_t armor_bit = uint64_t(1) << index;
+
+	DefenseFrontier merged;
+	merged.reserve(frontier.size() * 2);
+
+	size_t skip = 0, take = 0;
+	while (skip < frontier.size() || take < frontier.size()){
+		FrontierPoint next;
+		if (take == frontier.size()
+			|| (skip < frontier.size() && frontier[skip].cost_cents <= frontier[take].cost_cents + armor_cents)){
+			next = frontier[skip++];
+		}
+		else {
+			next = frontier[take++];
+			next.cost_cents += armor_cents;
+			next.defense += armor.defense();
+			next.mask |= armor_bit;
+		}
+
+		if (merged.empty() || next.defense > merged.back().defense){
+			if (!merged.empty() && merged.back().cost_cents == next.cost_cents){
+				merged.back() = next;
+			}
+			else {
+				merged.push_back(next);
+			}
+		}
+	}
+
+	frontier.swap(merged);
+}
+
+
+// Compute the Pareto frontier of all subsets of armors.
+// Each point is the best subset for every budget between its cost and the next point's cost.
+// To fit the masks, the size of the armor items vector must be less than 64.
+DefenseFrontier build_defense_frontier(const ArmorVector& armors)
+{
+	assert(armors.size() < 64);
+	DefenseFrontier frontier = { FrontierPoint{0, 0.0, 0} };
+	for (size_t j = 0; j < armors.size(); j++){
+		extend_defense_frontier(frontier, *armors[j], j);
+	}
+	return frontier;
+}
+
+
+// Find the frontier point with the greatest defense that fits within a total_cost gold budget.
+// Returns nullptr when even the empty subset does not fit, i.e. the budget is negative.
+const FrontierPoint* best_frontier_point
+(
+	const DefenseFrontier& frontier,
+	double total_cost
+)
+{
+	const int64_t budget_cents = budget_to_cents(total_cost);
+	auto after = std::upper_bound(
+		frontier.begin(), frontier.end(), budget_cents,
+		[](int64_t cents, const FrontierPoint& point) { return cents < point.cost_cents; }
+	);
+	if (after == frontier.begin()){
+		return nullptr;
+	}
+	return &*(after - 1);
+}
+
+
+// Compute the same optimal subsets as exhaustive_max_defense for several budgets at once.
+// The frontier of all subsets is built once, in at most O(2^n) time and usually far less,
+// and each budget is then answered with a binary search.
+// The i-th result is the solution for total_costs[i].
+// Costs are compared in cents, rounded up by gold_to_cents, so this is exact for whole-cent costs.
+// To avoid overflow, the size of the armor items vector must be less than 64.
+std::vector<std::unique_ptr<ArmorVector>> exhaustive_max_defense_multi
+(
+	const ArmorVector& armors,
+	const std::vector<double>& total_costs
+)
+{
+	DefenseFrontier frontier = build_defense_frontier(armors);
+
+	std::vector<std::unique_ptr<ArmorVector>> results;
+	for (double total_cost : total_costs){
+		const FrontierPoint* best = best_frontier_point(frontier, total_cost);
+		results.push_back(armor_vector_from_mask(armors, best ? best->mask : 0));
+	}
+	return results;
+}
+
+
+// Exact solver for a catalog that grows one armor item at a time.
+// The Pareto frontier of all subsets is kept between calls, and each add_item()
+// extends it in time linear in its size instead of redoing the whole enumeration.
+// As in exhaustive_max_defense_multi, costs are rounded up to whole cents.
+// To fit the masks, at most 63 armor items may be added.
+class IncrementalMaxDefense
+{
+	//
+	public:
+
+		//
+		IncrementalMaxDefense()
+			:
+			_frontier{ FrontierPoint{0, 0.0, 0} },
+			_last_update_seconds(0.0)
+		{
+		}
+
+		// Add one armor item to the catalog and extend the frontier to cover it.
+		void add_item(std::shared_ptr<ArmorItem> armor)
+		{
+			assert(armor);
+			assert(_armors.size() < 63);
+
+			Timer timer;
+			extend_defense_frontier(_frontier, *armor, _armors.size());
+			_armors.push_back(armor);
+			_last_update_seconds = timer.elapsed();
+		}
+
+		// The subset of the items added so far that exhaustive_max_defense
+		// would choose for a total_cost gold budget.
+		std::unique_ptr<ArmorVector> best(double total_cost) const
+		{
+			const FrontierPoint* point = best_frontier_point(_frontier, total_cost);
+			return armor_vector_from_mask(_armors, point ? point->mask : 0);
+		}
+
+		//
+		const ArmorVector& armors() const { return _armors; }
+		size_t frontier_size() const { return _frontier.size(); }
+
+		// Bytes currently allocated for the frontier.
+		size_t frontier_bytes() const { return _frontier.capacity() * sizeof(FrontierPoint); }
+
+		// Seconds spent in the most recent add_item() call.
+		double last_update_seconds() const { return _last_update_seconds; }
+
+	//
+	private:
+
+		// Items added so far; item j is bit j of the frontier masks.
+		ArmorVector _armors;
+
+		// Pareto frontier of all subsets of _armors.
+		DefenseFrontier _frontier;
+
+		//
+		double _last_update_seconds;
+};
+
+
+// Solve the 0/1 knapsack over items with whole-cent costs by dynamic programming.
+// Returns, for each item, whether it is in a subset of greatest total defense
+// whose cost is at most budget_cents.
+// Keeps one decision bit per item and budget cent to reconstruct the subset.
+std::vector<bool> knapsack_dp_select
+(
+	const std::vector<int64_t>& costs_cents,
+	const std::vector<double>& defenses,
+	int64_t budget_cents
+)
+{
+	assert(costs_cents.size() == defenses.size());
+	const size_t n = costs_cents.size();
+	std::vector<bool> taken(n, false);
+	if (budget_cents < 0){
+		return taken;
+	}
+
+	const size_t width = budget_cents + 1;
+	const size_t words = (width + 63) / 64;
+	std::vector<double> best(width, 0.0);
+	std::vector<uint64_t> decisions(n * words, 0);
+
+	for (size_t i = 0; i < n; i++){
+		const int64_t c = costs_cents[i];
+		const double d = defenses[i];
+		if (d <= 0 || c > budget_cents){
+			continue;
+		}
+		uint64_t* row = &decisions[i * words];
+		for (int64_t w = budget_cents; w >= c; w--){
+			if (best[w - c] + d > best[w]){
+				best[w] = best[w - c] + d;
+				row[w / 64] |= uint64_t(1) << (w % 64);
+			}
+		}
+	}
+
+	int64_t w = budget_cents;
+	for (size_t i = n; i-- > 0; ){
+		if ((decisions[i * words + w / 64] >> (w % 64)) & 1){
+			taken[i] = true;
+			w -= costs_cents[i];
+		}
+	}
+	return taken;
+}
+
+
+// Compute the optimal set of armor items with dynamic programming over the budget in cents.
+// Gives the same total defense as exhaustive_max_defense when costs are whole cents, with no limit
+// on the number of items, in O(n * budget) time and n * budget bits of memory.
+// Costs with fractions of a cent are rounded up (see gold_to_cents), so the set still fits.
+std::unique_ptr<ArmorVector> dynamic_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost
+)
+{
+	std::vector<int64_t> costs_cents;
+	std::vector<double> defenses;
+	for (auto& armor : armors){
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+		defenses.push_back(armor->defense());
+	}
+
+	std::vector<bool> taken = knapsack_dp_select(costs_cents, defenses, budget_to_cents(total_cost));
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (size_t j = 0; j < armors.size(); j++){
+		if (taken[j]){
+			result->push_back(armors[j]);
+		}
+	}
+	return result;
+}
+
+
+// A group of interchangeable armor items: every member has exactly the same cost and defense.
+// The multiplicity of the group is members.size().
+struct ArmorGroup
+{
+	int64_t cost_cents;
+	double defense;
+	ArmorVector members;
+};
+
+
+// Collapse identical items, i.e. items with exactly equal cost and defense, into groups.
+// Items that differ by less than a cent are kept apart, since taking the wrong one of them
+// would lose defense. Groups are in order of their first member, and members keep their order.
+std::vector<ArmorGroup> group_duplicate_armors(const ArmorVector& armors)
+{
+	std::vector<ArmorGroup> groups;
+	std::map<std::pair<double, double>, size_t> group_of;
+
+	for (auto& armor : armors){
+		auto key = std::make_pair(armor->cost(), armor->defense());
+		auto found = group_of.find(key);
+		if (found == group_of.end()){
+			group_of[key] = groups.size();
+			groups.push_back(ArmorGroup{gold_to_cents(armor->cost()), armor->defense(), ArmorVector{armor}});
+		}
+		else {
+			groups[found->second].members.push_back(armor);
+		}
+	}
+	return groups;
+}
+
+
+// Base 2 logarithm of the number of distinct choices an exact search over the groups
+// has to consider: each group of multiplicity m contributes m+1 choices,
+// where searching the ungrouped items would contribute 2^m.
+double grouped_search_space_log2(const std::vector<ArmorGroup>& groups)
+{
+	double bits = 0.0;
+	for (auto& group : groups){
+		bits += std::log2(group.members.size() + 1.0);
+	}
+	return bits;
+}
+
+
+// Compute the optimal set of armor items after collapsing duplicates into groups,
+// solving the resulting bounded knapsack exactly.
+// Each group of multiplicity m is split into pseudo-items of 1, 2, 4, ... copies
+// (binary splitting), so it costs O(log m) DP rows instead of m.
+// The chosen number of copies of each group is mapped back to that many of its members.
+// Like dynamic_max_defense, it rounds costs up to whole cents and is exact for whole-cent costs.
+std::unique_ptr<ArmorVector> bounded_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost
+)
+{
+	std::vector<ArmorGroup> groups = group_duplicate_armors(armors);
+
+	std::vector<int64_t> costs_cents;
+	std::vector<double> defenses;
+	std::vector<size_t> pseudo_group, pseudo_copies;
+	for (size_t g = 0; g < groups.size(); g++){
+		size_t remaining = groups[g].members.size();
+		for (size_t copies = 1; remaining > 0; copies *= 2){
+			copies = std::min(copies, remaining);
+			costs_cents.push_back(groups[g].cost_cents * copies);
+			defenses.push_back(groups[g].defense * copies);
+			pseudo_group.push_back(g);
+			pseudo_copies.push_back(copies);
+			remaining -= copies;
+		}
+	}
+
+	std::vector<bool> taken = knapsack_dp_select(costs_cents, defenses, budget_to_cents(total_cost));
+
+	std::vector<size_t> chosen(groups.size(), 0);
+	for (size_t i = 0; i < taken.size(); i++){
+		if (taken[i]){
+			chosen[pseudo_group[i]] += pseudo_copies[i];
+		}
+	}
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (size_t g = 0; g < groups.size(); g++){
+		result->insert(result->end(), groups[g].members.begin(), groups[g].members.begin() + chosen[g]);
+	}
+	return result;
+}
+
+
+// Drop the armor items that cannot be needed by any optimal solution within a total_cost budget,
+// so that they never reach a solver. An item is dropped when:
+//	1) its cost alone exceeds the budget;
+//	2) its defense is zero or negative; or
+//	3) it is dominated by so many other items (cost <= and defense >=) that no subset within
+//		the budget can contain the item together with all of them. Some dominating item is then
+//		left out of any solution containing this one, and swapping them in is no worse.
+// Of two identical items, the earlier one counts as dominating the later one.
+// Returns the remaining items in their original order; eliminated is set to the number dropped.
+std::unique_ptr<ArmorVector> prune_armor_vector
+(
+	const ArmorVector& source,
+	double total_cost,
+	size_t& eliminated
+)
+{
+	const int64_t budget_cents = budget_to_cents(total_cost);
+
+	std::vector<size_t> order;
+	std::vector<int64_t> costs_cents(source.size());
+	for (size_t j = 0; j < source.size(); j++){
+		costs_cents[j] = gold_to_cents(source[j]->cost());
+		if (costs_cents[j] <= budget_cents && source[j]->defense() > 0){
+			order.push_back(j);
+		}
+	}
+
+	// Cheapest first, then strongest first, then by position; everything dominating
+	// an item comes before it in this order.
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+	{
+		if (costs_cents[a] != costs_cents[b]){
+			return costs_cents[a] < costs_cents[b];
+		}
+		if (source[a]->defense() != source[b]->defense()){
+			return source[a]->defense() > source[b]->defense();
+		}
+		return a < b;
+	});
+
+	std::vector<bool> keep(source.size(), false);
+	for (size_t p = 0; p < order.size(); p++){
+		const size_t j = order[p];
+		const int64_t room = budget_cents - costs_cents[j];
+
+		// Add up the cheapest dominating items until they no longer fit beside this one.
+		int64_t dominating_cents = 0;
+		bool dominated = false;
+		for (size_t q = 0; q < p && !dominated; q++){
+			if (source[order[q]]->defense() >= source[j]->defense()){
+				dominating_cents += costs_cents[order[q]];
+				dominated = (dominating_cents > room);
+			}
+		}
+		keep[j] = !dominated;
+	}
+
+	std::unique_ptr<ArmorVector> pruned = std::make_unique<ArmorVector>();
+	for (size_t j = 0; j < source.size(); j++){
+		if (keep[j]){
+			pruned->push_back(source[j]);
+		}
+	}
+	eliminated = source.size() - pruned->size();
+	return pruned;
+}
+
+
+// Any exact solver with the same interface as exhaustive_max_defense.
+typedef std::function<std::unique_ptr<ArmorVector>(const ArmorVector&, double)> ArmorSolver;
+
+
+// Compute the optimal set of armor items by fixing as many items as possible before
+// calling an exact solver on the rest (Ingargiola-Korsh style reduction).
+// The greedy solution gives a lower bound on the optimum. An item is fixed out when
+// even the LP relaxation with the item forced in cannot reach that bound, and fixed in
+// when the LP relaxation without it cannot; items that do not fit or have no defense are
+// fixed out as well. Only the remaining "core" items, with the budget that is left,
+// are passed to solver.
+// fixed_count is set to the number of items whose status was decided by the reduction.
+std::unique_ptr<ArmorVector> reduced_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost,
+	const ArmorSolver& solver,
+	size_t& fixed_count
+)
+{
+	const int64_t budget_cents = budget_to_cents(total_cost);
+
+	// Candidates in order of decreasing defense per gold, ties by position.
+	std::vector<size_t> order;
+	std::vector<int64_t> costs_cents(armors.size());
+	for (size_t j = 0; j < armors.size(); j++){
+		costs_cents[j] = gold_to_cents(armors[j]->cost());
+		if (costs_cents[j] <= budget_cents && armors[j]->defense() > 0){
+			order.push_back(j);
+		}
+	}
+	auto ratio = [&](size_t j) { return armors[j]->defense() / costs_cents[j]; };
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ratio(a) > ratio(b); });
+
+	const size_t m = order.size();
+	std::vector<int64_t> prefix_cents(m + 1, 0);
+	std::vector<double> prefix_defense(m + 1, 0.0);
+	for (size_t p = 0; p < m; p++){
+		prefix_cents[p + 1] = prefix_cents[p] + costs_cents[order[p]];
+		prefix_defense[p + 1] = prefix_defense[p] + armors[order[p]]->defense();
+	}
+
+	// Greedy lower bound: take items in ratio order whenever they still fit.
+	double lower_bound = 0.0;
+	std::vector<bool> greedy_taken(armors.size(), false);
+	int64_t greedy_cents = 0;
+	for (size_t j : order){
+		if (greedy_cents + costs_cents[j] <= budget_cents){
+			greedy_cents += costs_cents[j];
+			lower_bound += armors[j]->defense();
+			greedy_taken[j] = true;
+		}
+	}
+
+	// LP relaxation bound over all candidates except the one at position skip, within capacity cents.
+	auto lp_bound = [&](int64_t capacity, size_t skip)
+	{
+		if (capacity < 0){
+			return -1.0;
+		}
+		auto cents_before = [&](size_t k) { return prefix_cents[k] - (skip < k ? costs_cents[order[skip]] : 0); };
+		auto defense_before = [&](size_t k) { return prefix_defense[k] - (skip < k ? armors[order[skip]]->defense() : 0.0); };
+
+		// Largest k such that the first k candidates, less the skipped one, fit.
+		size_t low = 0, high = m;
+		while (low < high){
+			size_t mid = (low + high + 1) / 2;
+			if (cents_before(mid) <= capacity){
+				low = mid;
+			}
+			else {
+				high = mid - 1;
+			}
+		}
+		size_t next = (low == skip) ? low + 1 : low;
+		double bound = defense_before(low);
+		if (next < m){
+			bound += (capacity - cents_before(low)) * ratio(order[next]);
+		}
+		return bound;
+	};
+
+	const double tolerance = 1e-9 * std::max(1.0, lower_bound);
+	std::vector<bool> fixed_in(armors.size(), false), in_core(armors.size(), false);
+	int64_t fixed_cents = 0;
+	fixed_count = armors.size();
+	for (size_t p = 0; p < m; p++){
+		const size_t j = order[p];
+		const double with_item = armors[j]->defense() + lp_bound(budget_cents - costs_cents[j], p);
+		const double without_item = lp_bound(budget_cents, p);
+		if (with_item < lower_bound - tolerance){
+			continue;
+		}
+		if (without_item < lower_bound - tolerance){
+			fixed_in[j] = true;
+			fixed_cents += costs_cents[j];
+			continue;
+		}
+		in_core[j] = true;
+		fixed_count--;
+	}
+
+	ArmorVector core;
+	for (size_t j = 0; j < armors.size(); j++){
+		if (in_core[j]){
+			core.push_back(armors[j]);
+		}
+	}
+	std::unique_ptr<ArmorVector> core_solution = solver(core, (budget_cents - fixed_cents) / 100.0);
+
+	// Put the fixed and the core items back together, in their original order.
+	std::map<const ArmorItem*, size_t> core_taken;
+	for (auto& armor : *core_solution){
+		core_taken[armor.get()]++;
+	}
+	std::vector<bool> taken(fixed_in);
+	double defense = 0.0;
+	for (size_t j = 0; j < armors.size(); j++){
+		auto found = core_taken.find(armors[j].get());
+		if (in_core[j] && found != core_taken.end() && found->second > 0){
+			taken[j] = true;
+			found->second--;
+		}
+		if (taken[j]){
+			defense += armors[j]->defense();
+		}
+	}
+	if (defense < lower_bound - tolerance){
+		taken = greedy_taken;
+	}
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (size_t j = 0; j < armors.size(); j++){
+		if (taken[j]){
+			result->push_back(armors[j]);
+		}
+	}
+	return result;
+}
+
+
+// The candidates of an armor vector for the bound-based solvers below: the items that fit
+// in the budget and have positive defense, in order of decreasing defense per gold
+// (ties by position), with prefix sums of their costs in cents and of their defense.
+struct RatioOrder
+{
+	std::vector<size_t> index;
+	std::vector<int64_t> cents;
+	std::vector<double> defense, ratio;
+	std::vector<int64_t> prefix_cents;
+	std::vector<double> prefix_defense;
+};
+
+
+// Build the RatioOrder of armors for a budget in cents.
+RatioOrder make_ratio_order(const ArmorVector& armors, int64_t budget_cents)
+{
+	RatioOrder order;
+	std::vector<double> ratios(armors.size());
+	for (size_t j = 0; j < armors.size(); j++){
+		const int64_t cents = gold_to_cents(armors[j]->cost());
+		if (cents <= budget_cents && armors[j]->defense() > 0){
+			order.index.push_back(j);
+			ratios[j] = armors[j]->defense() / cents;
+		}
+	}
+	std::stable_sort(order.index.begin(), order.index.end(), [&](size_t a, size_t b) { return ratios[a] > ratios[b]; });
+
+	order.prefix_cents.push_back(0);
+	order.prefix_defense.push_back(0.0);
+	for (size_t j : order.index){
+		order.cents.push_back(gold_to_cents(armors[j]->cost()));
+		order.defense.push_back(armors[j]->defense());
+		order.ratio.push_back(ratios[j]);
+		order.prefix_cents.push_back(order.prefix_cents.back() + order.cents.back());
+		order.prefix_defense.push_back(order.prefix_defense.back() + order.defense.back());
+	}
+	return order;
+}
+
+
+// Build the result ArmorVector from the positions in a RatioOrder that are taken, in original order.
+std::unique_ptr<ArmorVector> armor_vector_from_order
+(
+	const ArmorVector& armors,
+	const RatioOrder& order,
+	const std::vector<bool>& taken
+)
+{
+	std::vector<bool> chosen(armors.size(), false);
+	for (size_t p = 0; p < taken.size(); p++){
+		if (taken[p]){
+			chosen[order.index[p]] = true;
+		}
+	}
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (size_t j = 0; j < armors.size(); j++){
+		if (chosen[j]){
+			result->push_back(armors[j]);
+		}
+	}
+	return result;
+}
+
+
+// State of a depth-first branch-and-bound search over a RatioOrder.
+struct BranchBoundSearch
+{
+	const RatioOrder& order;
+	int64_t budget_cents;
+	size_t max_items;
+
+	// suffix_max_defense[p] is the greatest defense at positions p onwards.
+	std::vector<double> suffix_max_defense;
+
+	std::vector<bool> current, best;
+	double best_defense;
+};
+
+
+// Explore the subtree that decides positions p onwards, given the cost, defense and number
+// of items of the decisions so far. A subtree is cut when its LP relaxation bound, or the
+// bound from the number of items it may still take, cannot beat the best found.
+void branch_bound_search
+(
+	BranchBoundSearch& search,
+	size_t p,
+	int64_t cost_cents,
+	double defense,
+	size_t items
+)
+{
+	const RatioOrder& order = search.order;
+	const size_t m = order.index.size();
+
+	if (defense > search.best_defense){
+		search.best_defense = defense;
+		search.best = search.current;
+	}
+	if (p == m || items == search.max_items){
+		return;
+	}
+
+	// LP bound: fill the remaining budget with the next items in ratio order.
+	const int64_t room = search.budget_cents - cost_cents;
+	const int64_t* fit = std::upper_bound(&order.prefix_cents[p], &order.prefix_cents[m] + 1, order.prefix_cents[p] + room) - 1;
+	const size_t k = fit - &order.prefix_cents[0];
+	double bound = defense + order.prefix_defense[k] - order.prefix_defense[p];
+	if (k < m){
+		bound += (room - (order.prefix_cents[k] - order.prefix_cents[p])) * order.ratio[k];
+	}
+	if (search.max_items - items < m - p){
+		bound = std::min(bound, defense + (search.max_items - items) * search.suffix_max_defense[p]);
+	}
+	if (bound <= search.best_defense * (1 + 1e-12)){
+		return;
+	}
+
+	if (order.cents[p] <= room){
+		search.current[p] = true;
+		branch_bound_search(search, p + 1, cost_cents + order.cents[p], defense + order.defense[p], items + 1);
+		search.current[p] = false;
+	}
+	branch_bound_search(search, p + 1, cost_cents, defense, items);
+}
+
+
+// Compute the optimal set of at most max_items armor items with a depth-first
+// branch-and-bound search (Horowitz-Sahni), visiting items by decreasing defense per gold
+// and taking each item before leaving it out.
+// Costs are counted in cents, rounded up by gold_to_cents: the result always fits, and is
+// optimal when every cost is a whole number of cents.
+std::unique_ptr<ArmorVector> branch_bound_max_defense_limited
+(
+	const ArmorVector& armors,
+	double total_cost,
+	size_t max_items
+)
+{
+	const int64_t budget_cents = budget_to_cents(total_cost);
+	RatioOrder order = make_ratio_order(armors, budget_cents);
+	const size_t m = order.index.size();
+
+	BranchBoundSearch search{ order, budget_cents, max_items, std::vector<double>(m + 1, 0.0), std::vector<bool>(m, false), std::vector<bool>(m, false), 0.0 };
+	for (size_t p = m; p-- > 0; ){
+		search.suffix_max_defense[p] = std::max(search.suffix_max_defense[p + 1], order.defense[p]);
+	}
+	if (budget_cents >= 0){
+		branch_bound_search(search, 0, 0, 0.0, 0);
+	}
+	return armor_vector_from_order(armors, order, search.best);
+}
+
+
+// Compute the optimal set of armor items with a depth-first branch-and-bound search,
+// with no limit on the number of items. Gives the same total defense as exhaustive_max_defense
+// when costs are whole cents; see branch_bound_max_defense_limited.
+std::unique_ptr<ArmorVector> branch_bound_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost
+)
+{
+	return branch_bound_max_defense_limited(armors, total_cost, std::numeric_limits<size_t>::max());
+}
+
+
+// One item flipped away from the break solution by the core solver; the flips of a state
+// form a persistent linked list shared with the states it was derived from.
+struct CoreFlip
+{
+	size_t position;
+	std::shared_ptr<const CoreFlip> previous;
+};
+
+
+// A partial solution of the core solver: the break solution with some flips applied.
+// Its cost may exceed the budget while items can still be removed.
+struct CoreState
+{
+	int64_t cost_cents;
+	double defense;
+	std::shared_ptr<const CoreFlip> flips;
+};
+
+
+// Compute the optimal set of armor items with an expanding core algorithm (after Pisinger).
+// Items are sorted by decreasing defense per gold, and the break solution takes the longest
+// prefix that fits. The core starts empty at the break item and grows one item at a time,
+// alternately to the right (an item that may be added) and to the left (an item that may be
+// removed). A list of undominated states is kept for the choices inside the core, and a state
+// is dropped once its LP bound cannot beat the best feasible state; the search ends when no
+// state is left, usually long before the core covers the catalog.
+// Gives the same total defense as exhaustive_max_defense when costs are whole cents; other
+// costs are rounded up to the next cent, so the result never exceeds the budget.
+std::unique_ptr<ArmorVector> core_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost
+)
+{
+	const int64_t budget_cents = budget_to_cents(total_cost);
+	RatioOrder order = make_ratio_order(armors, budget_cents);
+	const size_t m = order.index.size();
+	if (budget_cents < 0){
+		return std::make_unique<ArmorVector>();
+	}
+
+	const size_t break_item = std::upper_bound(order.prefix_cents.begin(), order.prefix_cents.end(), budget_cents) - order.prefix_cents.begin() - 1;
+	std::vector<CoreState> states = { CoreState{order.prefix_cents[break_item], order.prefix_defense[break_item], nullptr} };
+	CoreState incumbent = states[0];
+
+	// Positions [left, right) are in the core; those before are taken and those after are not.
+	size_t left = break_item, right = break_item;
+	bool grow_right = true;
+	while (!states.empty() && (left > 0 || right < m)){
+		size_t position;
+		int sign;
+		if ((grow_right && right < m) || left == 0){
+			position = right++;
+			sign = 1;
+		}
+		else {
+			position = --left;
+			sign = -1;
+		}
+		grow_right = !grow_right;
+
+		// Merge the states that keep the item as it is with the states that flip it.
+		const int64_t flip_cents = sign * order.cents[position];
+		const double flip_defense = sign * order.defense[position];
+		std::vector<CoreState> merged;
+		merged.reserve(states.size() * 2);
+		size_t keep = 0, flip = 0;
+		while (keep < states.size() || flip < states.size()){
+			CoreState next;
+			if (flip == states.size()
+				|| (keep < states.size() && states[keep].cost_cents <= states[flip].cost_cents + flip_cents)){
+				next = states[keep++];
+			}
+			else {
+				next = states[flip];
+				next.cost_cents += flip_cents;
+				next.defense += flip_defense;
+				next.flips = std::make_shared<const CoreFlip>(CoreFlip{position, states[flip].flips});
+				flip++;
+			}
+
+			if (next.cost_cents <= budget_cents && next.defense > incumbent.defense){
+				incumbent = next;
+			}
+			if (merged.empty() || next.defense > merged.back().defense){
+				if (!merged.empty() && merged.back().cost_cents == next.cost_cents){
+					merged.back() = next;
+				}
+				else {
+					merged.push_back(next);
+				}
+			}
+		}
+
+		// Keep only the states whose LP bound can still beat the incumbent.
+		const double add_ratio = (right < m) ? order.ratio[right] : 0.0;
+		const double threshold = incumbent.defense * (1 + 1e-12);
+		states.clear();
+		for (auto& state : merged){
+			double bound;
+			if (state.cost_cents <= budget_cents){
+				bound = state.defense + (budget_cents - state.cost_cents) * add_ratio;
+			}
+			else if (left > 0){
+				bound = state.defense - (state.cost_cents - budget_cents) * order.ratio[left - 1];
+			}
+			else {
+				continue;
+			}
+			if (bound > threshold){
+				states.push_back(state);
+			}
+		}
+	}
+
+	std::vector<bool> taken(m, false);
+	for (size_t p = 0; p < break_item; p++){
+		taken[p] = true;
+	}
+	for (const CoreFlip* flip = incumbent.flips.get(); flip; flip = flip->previous.get()){
+		taken[flip->position] = !taken[flip->position];
+	}
+	return armor_vector_from_order(armors, order, taken);
+}
+
+
+// Fill row[w], for w = 0 .. budget_cents, with the greatest total defense of a subset of
+// items [begin, end) costing at most w cents. Items are given by their cost in cents and
+// defense; the classic rolling 0/1 knapsack DP, in O((end - begin) * budget_cents) time.
+// A negative budget leaves row empty.
+void knapsack_dp_row
+(
+	const std::vector<int64_t>& costs_cents,
+	const std::vector<double>& defenses,
+	size_t begin,
+	size_t end,
+	int64_t budget_cents,
+	std::vector<double>& row
+)
+{
+	if (budget_cents < 0){
+		row.clear();
+		return;
+	}
+	row.assign(budget_cents + 1, 0.0);
+	for (size_t i = begin; i < end; i++){
+		const int64_t c = costs_cents[i];
+		const double d = defenses[i];
+		if (d <= 0 || c > budget_cents){
+			continue;
+		}
+		for (int64_t w = budget_cents; w >= c; w--){
+			row[w] = std::max(row[w], row[w - c] + d);
+		}
+	}
+}
+
+
+// dst[i] = max(dst[i], src[i] + defense) for i < count. The two spans must not overlap,
+// which lets the compiler vectorize the loop.
+inline void knapsack_update_span
+(
+	double* __restrict__ dst,
+	const double* __restrict__ src,
+	size_t count,
+	double defense
+)
+{
+	for (size_t i = 0; i < count; i++){
+		dst[i] = std::max(dst[i], src[i] + defense);
+	}
+}
+
+
+// Same result as knapsack_dp_row, computed with a cache-blocked, vectorized kernel.
+// The budget axis is cut into tiles of tile_cents, and items_per_pass items sweep down the
+// tiles together as a wavefront: each item trails the previous one by enough tiles that the
+// values it reads are final, so a tile is reused by every item of the pass while it is still
+// in cache, instead of streaming the whole row once per item. Within a tile, an item updates
+// spans no longer than its cost, which cannot overlap the values they read.
+void knapsack_dp_row_tiled
+(
+	const std::vector<int64_t>& costs_cents,
+	const std::vector<double>& defenses,
+	size_t begin,
+	size_t end,
+	int64_t budget_cents,
+	std::vector<double>& row,
+	size_t items_per_pass = 8,
+	int64_t tile_cents = 2048
+)
+{
+	if (budget_cents < 0){
+		row.clear();
+		return;
+	}
+	row.assign(budget_cents + 1, 0.0);
+
+	std::vector<size_t> items;
+	for (size_t i = begin; i < end; i++){
+		if (defenses[i] > 0 && costs_cents[i] <= budget_cents){
+			items.push_back(i);
+		}
+	}
+
+	const int64_t tiles = budget_cents / tile_cents + 1;
+	std::vector<int64_t> lag;
+	for (size_t first = 0; first < items.size(); ){
+		// An item that costs 0 cents adds its defense to every total, as in knapsack_dp_row;
+		// it cannot go through the spans below, which are at most its cost long.
+		if (costs_cents[items[first]] == 0){
+			for (auto& value : row){
+				value += defenses[items[first]];
+			}
+			first++;
+			continue;
+		}
+
+		// A pass ends early at the next item that costs 0 cents.
+		size_t count = 0;
+		while (count < items_per_pass && first + count < items.size() && costs_cents[items[first + count]] > 0){
+			count++;
+		}
+
+		// Item j of the pass works on tile (tiles - 1 - (step - lag[j])).
+		lag.assign(count, 0);
+		for (size_t j = 1; j < count; j++){
+			lag[j] = lag[j - 1] + (costs_cents[items[first + j]] + tile_cents - 1) / tile_cents + 1;
+		}
+
+		for (int64_t step = 0; step < tiles + lag[count - 1]; step++){
+			for (size_t j = 0; j < count; j++){
+				const int64_t tile = tiles - 1 - (step - lag[j]);
+				if (tile < 0 || tile >= tiles){
+					continue;
+				}
+				const int64_t c = costs_cents[items[first + j]];
+				const double d = defenses[items[first + j]];
+				const int64_t low = std::max(tile * tile_cents, c);
+				int64_t high = std::min(tile * tile_cents + tile_cents - 1, budget_cents);
+				while (high >= low){
+					const int64_t span_low = std::max(low, high - c + 1);
+					knapsack_update_span(&row[span_low], &row[span_low - c], high - span_low + 1, d);
+					high = span_low - 1;
+				}
+			}
+		}
+		first += count;
+	}
+}
+
+
+// A reusable barrier for a fixed number of threads; each call to wait() blocks until
+// all of them have called it.
+class ThreadBarrier
+{
+	//
+	public:
+
+		//
+		explicit ThreadBarrier(size_t count)
+			:
+			_count(count),
+			_waiting(0),
+			_generation(0)
+		{
+			assert(count > 0);
+		}
+
+		//
+		void wait()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			const size_t generation = _generation;
+			if (++_waiting == _count){
+				_waiting = 0;
+				_generation++;
+				_released.notify_all();
+			}
+			else {
+				_released.wait(lock, [&]() { return _generation != generation; });
+			}
+		}
+
+	//
+	private:
+
+		//
+		std::mutex _mutex;
+		std::condition_variable _released;
+		size_t _count, _waiting, _generation;
+};
+
+
+// out[i] = max(in[i], shifted[i] + defense) for i < count; out must not overlap the inputs.
+inline void knapsack_step_span
+(
+	double* __restrict__ out,
+	const double* __restrict__ in,
+	const double* __restrict__ shifted,
+	size_t count,
+	double defense
+)
+{
+	for (size_t i = 0; i < count; i++){
+		out[i] = std::max(in[i], shifted[i] + defense);
+	}
+}
+
+
+// Same result as knapsack_dp_row, computed by several threads. The budget axis is split into
+// one contiguous chunk per thread. Each item step reads one row and writes the other of a
+// pair of rows, and all threads meet at a barrier before the next item.
+// Every thread first touches the pages of its own chunks, so on a NUMA host they are
+// allocated on the node where that thread runs and stay local for the whole computation.
+void knapsack_dp_row_parallel
+(
+	const std::vector<int64_t>& costs_cents,
+	const std::vector<double>& defenses,
+	size_t begin,
+	size_t end,
+	int64_t budget_cents,
+	std::vector<double>& row,
+	size_t threads
+)
+{
+	assert(threads > 0);
+	if (budget_cents < 0){
+		row.clear();
+		return;
+	}
+
+	std::vector<size_t> items;
+	for (size_t i = begin; i < end; i++){
+		if (defenses[i] > 0 && costs_cents[i] <= budget_cents){
+			items.push_back(i);
+		}
+	}
+
+	// Left uninitialized, so that the first touch happens in the owning thread.
+	const int64_t width = budget_cents + 1;
+	std::unique_ptr<double[]> first_row(new double[width]), second_row(new double[width]);
+	ThreadBarrier barrier(threads);
+
+	auto worker = [&](size_t t)
+	{
+		const int64_t low = width * t / threads, high = width * (t + 1) / threads;
+		double* current = first_row.get();
+		double* next = second_row.get();
+		std::fill(current + low, current + high, 0.0);
+		std::fill(next + low, next + high, 0.0);
+		barrier.wait();
+
+		for (size_t i : items){
+			const int64_t c = costs_cents[i];
+			const int64_t split = std::min(std::max(low, c), high);
+			std::copy(current + low, current + split, next + low);
+			knapsack_step_span(next + split, current + split, current + split - c, high - split, defenses[i]);
+			std::swap(current, next);
+			barrier.wait();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (size_t t = 1; t < threads; t++){
+		pool.push_back(std::thread(worker, t));
+	}
+	worker(0);
+	for (auto& thread : pool){
+		thread.join();
+	}
+
+	const double* result = (items.size() % 2 == 0) ? first_row.get() : second_row.get();
+	row.assign(result, result + width);
+}
+
+
+// Decide which of the items [begin, end) to take within budget_cents, Hirschberg style:
+// compute the DP row of each half, choose the split of the budget that maximizes their sum,
+// and recurse into both halves with their share. When parallel_depth is positive, the two
+// halves are handled by separate threads, down to that many levels of recursion.
+// When row_threads > 1, the DP rows of at least 4096 cents per thread are each computed by
+// knapsack_dp_row_parallel with that many threads.
+void hirschberg_select
+(
+	const std::vector<int64_t>& costs_cents,
+	const std::vector<double>& defenses,
+	size_t begin,
+	size_t end,
+	int64_t budget_cents,
+	int parallel_depth,
+	size_t row_threads,
+	std::vector<bool>& taken
+)
+{
+	if (end - begin == 1){
+		taken[begin] = (defenses[begin] > 0 && costs_cents[begin] <= budget_cents);
+		return;
+	}
+	if (end == begin || budget_cents < 0){
+		return;
+	}
+
+	const size_t middle = begin + (end - begin) / 2;
+	auto dp_row = [&](size_t row_begin, size_t row_end, std::vector<double>& row)
+	{
+		if (row_threads > 1 && budget_cents >= int64_t(4096 * row_threads)){
+			knapsack_dp_row_parallel(costs_cents, defenses, row_begin, row_end, budget_cents, row, row_threads);
+		}
+		else {
+			knapsack_dp_row_tiled(costs_cents, defenses, row_begin, row_end, budget_cents, row);
+		}
+	};
+	std::vector<double> left_row, right_row;
+	if (parallel_depth > 0){
+		std::thread left_thread(dp_row, begin, middle, std::ref(left_row));
+		dp_row(middle, end, right_row);
+		left_thread.join();
+	}
+	else {
+		dp_row(begin, middle, left_row);
+		dp_row(middle, end, right_row);
+	}
+
+	int64_t left_budget = 0;
+	for (int64_t w = 0; w <= budget_cents; w++){
+		if (left_row[w] + right_row[budget_cents - w] > left_row[left_budget] + right_row[budget_cents - left_budget]){
+			left_budget = w;
+		}
+	}
+	left_row = std::vector<double>();
+	right_row = std::vector<double>();
+
+	// The halves write disjoint elements of taken, but std::vector<bool> packs them into
+	// shared words, so each thread decides into its own vector and the results are merged.
+	if (parallel_depth > 0){
+		std::vector<bool> left_taken(taken.size(), false);
+		std::thread left_thread(
+			hirschberg_select, std::cref(costs_cents), std::cref(defenses), begin, middle, left_budget, parallel_depth - 1, row_threads, std::ref(left_taken)
+		);
+		hirschberg_select(costs_cents, defenses, middle, end, budget_cents - left_budget, parallel_depth - 1, row_threads, taken);
+		left_thread.join();
+		for (size_t i = begin; i < middle; i++){
+			taken[i] = left_taken[i];
+		}
+	}
+	else {
+		hirschberg_select(costs_cents, defenses, begin, middle, left_budget, 0, row_threads, taken);
+		hirschberg_select(costs_cents, defenses, middle, end, budget_cents - left_budget, 0, row_threads, taken);
+	}
+}
+
+
+// Compute the optimal set of armor items with dynamic programming, like dynamic_max_defense,
+// but without a decision table: the set is recovered by divide and conquer over the items,
+// so memory stays O(budget) value rows instead of n * budget bits, for about twice the time.
+// With parallel_depth > 0, the halves of the top parallel_depth levels run in separate threads.
+// With row_threads > 1, each wide enough DP row is also split across that many threads along
+// the budget axis, with knapsack_dp_row_parallel.
+// As in dynamic_max_defense, costs are rounded up to whole cents.
+std::unique_ptr<ArmorVector> hirschberg_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost,
+	int parallel_depth = 0,
+	size_t row_threads = 1
+)
+{
+	std::vector<int64_t> costs_cents;
+	std::vector<double> defenses;
+	for (auto& armor : armors){
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+		defenses.push_back(armor->defense());
+	}
+
+	std::vector<bool> taken(armors.size(), false);
+	hirschberg_select(costs_cents, defenses, 0, armors.size(), budget_to_cents(total_cost), parallel_depth, row_threads, taken);
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	for (size_t j = 0; j < armors.size(); j++){
+		if (taken[j]){
+			result->push_back(armors[j]);
+		}
+	}
+	return result;
+}
+
+
+// Find the greatest total cost, in cents, of a subset of items that is at most budget_cents.
+// Reachable totals are tracked in a bitset, one bit per cent, and each item shifts it by its
+// cost and ORs it in, 64 totals per word operation. Returns -1 when budget_cents is negative.
+int64_t closest_reachable_cents
+(
+	const std::vector<int64_t>& costs_cents,
+	int64_t budget_cents
+)
+{
+	if (budget_cents < 0){
+		return -1;
+	}
+
+	const size_t words = budget_cents / 64 + 1;
+	std::vector<uint64_t> reachable(words, 0);
+	reachable[0] = 1;
+
+	for (int64_t c : costs_cents){
+		if (c > budget_cents){
+			continue;
+		}
+		const size_t word_shift = c / 64, bit_shift = c % 64;
+		for (size_t i = words; i-- > word_shift; ){
+			uint64_t shifted = reachable[i - word_shift] << bit_shift;
+			if (bit_shift && i > word_shift){
+				shifted |= reachable[i - word_shift - 1] >> (64 - bit_shift);
+			}
+			reachable[i] |= shifted;
+		}
+	}
+
+	// Bits past budget_cents in the last word are not wanted.
+	const size_t last_bits = budget_cents % 64 + 1;
+	if (last_bits < 64){
+		reachable[words - 1] &= (uint64_t(1) << last_bits) - 1;
+	}
+	for (size_t i = words; i-- > 0; ){
+		if (reachable[i]){
+			return int64_t(i) * 64 + 63 - __builtin_clzll(reachable[i]);
+		}
+	}
+	return 0;
+}
+
+
+// Compute the set of armor items that spends as much of the total_cost budget as possible,
+// i.e. exactly the closest reachable amount not above it, and among the sets that spend
+// exactly that amount, the one with the greatest defense.
+// The spend is found with closest_reachable_cents; the set is then recovered with a DP over
+// exact costs up to that spend. Spends are in cents, with costs rounded up by gold_to_cents.
+std::unique_ptr<ArmorVector> exact_spend_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost
+)
+{
+	std::vector<int64_t> costs_cents;
+	for (auto& armor : armors){
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+	}
+
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	const int64_t spend = closest_reachable_cents(costs_cents, budget_to_cents(total_cost));
+	if (spend <= 0){
+		return result;
+	}
+
+	// best[w] is the greatest defense of a subset costing exactly w cents; NaN when unreachable.
+	const size_t n = armors.size();
+	const size_t words = spend / 64 + 1;
+	const double unreachable = std::numeric_limits<double>::quiet_NaN();
+	std::vector<double> best(spend + 1, unreachable);
+	std::vector<uint64_t> decisions(n * words, 0);
+	best[0] = 0.0;
+
+	for (size_t i = 0; i < n; i++){
+		const int64_t c = costs_cents[i];
+		const double d = armors[i]->defense();
+		uint64_t* row = &decisions[i * words];
+		for (int64_t w = spend; w >= c; w--){
+			if (!std::isnan(best[w - c]) && (std::isnan(best[w]) || best[w - c] + d > best[w])){
+				best[w] = best[w - c] + d;
+				row[w / 64] |= uint64_t(1) << (w % 64);
+			}
+		}
+	}
+
+	std::vector<bool> taken(n, false);
+	int64_t w = spend;
+	for (size_t i = n; i-- > 0; ){
+		if ((decisions[i * words + w / 64] >> (w % 64)) & 1){
+			taken[i] = true;
+			w -= costs_cents[i];
+		}
+	}
+	assert(w == 0);
+
+	for (size_t j = 0; j < n; j++){
+		if (taken[j]){
+			result->push_back(armors[j]);
+		}
+	}
+	return result;
+}
+
+
+// Compute the optimal set of at most max_items armor items with an exhaustive search.
+// Instead of all 2^n subsets, only the masks with popcount <= max_items are enumerated,
+// size by size, stepping to the next mask of the same popcount with Gosper's hack;
+// that is sum of C(n, k) for k <= max_items subsets, far fewer than 2^n when max_items is small.
+// Costs are summed in cents, rounded up, so it is exact for whole-cent costs.
+// To avoid overflow, the size of the armor items vector must be less than 64.
+std::unique_ptr<ArmorVector> exhaustive_max_defense_limited
+(
+	const ArmorVector& armors,
+	double total_cost,
+	size_t max_items
+)
+{
+	const int n = armors.size();
+	assert(n < 64);
+	const uint64_t end = uint64_t(1) << n;
+	const int64_t budget_cents = budget_to_cents(total_cost);
+
+	std::vector<int64_t> costs_cents;
+	for (auto& armor : armors){
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+	}
+
+	uint64_t best_mask = 0;
+	double best_defense = 0.0;
+	const int max_k = std::min<size_t>(max_items, n);
+	for (int k = 1; k <= max_k; k++){
+		for (uint64_t bits = (uint64_t(1) << k) - 1; bits < end; ){
+			int64_t cost = 0;
+			double defense = 0.0;
+			for (uint64_t rest = bits; rest; rest &= rest - 1){
+				const int j = __builtin_ctzll(rest);
+				cost += costs_cents[j];
+				defense += armors[j]->defense();
+			}
+			if (cost <= budget_cents && defense > best_defense){
+				best_defense = defense;
+				best_mask = bits;
+			}
+
+			// Gosper's hack: the next larger integer with the same number of set bits.
+			const uint64_t lowest = bits & -bits;
+			const uint64_t ripple = bits + lowest;
+			bits = (((ripple ^ bits) >> 2) / lowest) | ripple;
+		}
+	}
+	return armor_vector_from_mask(armors, best_mask);
+}
+
+
+// The equipment slot an armor item occupies, i.e. the slot noun its description ends with,
+// e.g. "chest plate" for "used high-quality mystical human chest plate".
+// Descriptions that end with no known slot noun are their own slot, named by their last word.
+std::string armor_slot(const std::string& description)
+{
+	static const std::vector<std::string> slots =
+	{
+		"chest plate", "shield", "helmet", "gloves", "gauntlets", "boots", "belt"
+	};
+	for (auto& slot : slots){
+		if (description.size() >= slot.size()
+			&& description.compare(description.size() - slot.size(), slot.size(), slot) == 0
+			&& (description.size() == slot.size() || description[description.size() - slot.size() - 1] == ' ')){
+			return slot;
+		}
+	}
+	size_t space = description.find_last_of(' ');
+	return (space == std::string::npos) ? description : description.substr(space + 1);
+}
+
+
+// Compute the optimal loadout, i.e. at most one armor item per slot, within a total_cost budget.
+// This is a multiple-choice knapsack: items are grouped by armor_slot(), items dominated by
+// another of the same slot (cost >= and defense <=) are dropped, and a DP over the budget
+// in cents chooses one item or none from each group.
+// Items are returned in the order their slots first appear in armors.
+// Costs are rounded up to whole cents, as by gold_to_cents, so the loadout always fits.
+std::unique_ptr<ArmorVector> slot_max_defense
+(
+	const ArmorVector& armors,
+	double total_cost
+)
+{
+	std::unique_ptr<ArmorVector> result = std::make_unique<ArmorVector>();
+	const int64_t budget_cents = budget_to_cents(total_cost);
+	if (budget_cents < 0){
+		return result;
+	}
+
+	std::vector<std::vector<size_t>> groups;
+	std::map<std::string, size_t> group_of;
+	for (size_t j = 0; j < armors.size(); j++){
+		if (armors[j]->defense() <= 0 || gold_to_cents(armors[j]->cost()) > budget_cents){
+			continue;
+		}
+		std::string slot = armor_slot(armors[j]->description());
+		auto found = group_of.find(slot);
+		if (found == group_of.end()){
+			group_of[slot] = groups.size();
+			groups.push_back({ j });
+		}
+		else {
+			groups[found->second].push_back(j);
+		}
+	}
+
+	// Within each slot, keep only the items on the cost/defense frontier.
+	for (auto& group : groups){
+		std::stable_sort(group.begin(), group.end(), [&](size_t a, size_t b)
+		{
+			return gold_to_cents(armors[a]->cost()) < gold_to_cents(armors[b]->cost());
+		});
+		std::vector<size_t> frontier;
+		for (size_t j : group){
+			if (frontier.empty() || armors[j]->defense() > armors[frontier.back()]->defense()){
+				if (!frontier.empty() && gold_to_cents(armors[frontier.back()]->cost()) == gold_to_cents(armors[j]->cost())){
+					frontier.back() = j;
+				}
+				else {
+					frontier.push_back(j);
+				}
+			}
+		}
+		group.swap(frontier);
+	}
+
+	// choice[g][w] is the item chosen from group g with w cents left for groups 0..g, or -1 for none.
+	const size_t width = budget_cents + 1;
+	std::vector<double> previous(width, 0.0), current(width);
+	std::vector<std::vector<int32_t>> choice(groups.size(), std::vector<int32_t>(width, -1));
+	for (size_t g = 0; g < groups.size(); g++){
+		current = previous;
+		for (size_t k = 0; k < groups[g].size(); k++){
+			const int64_t c = gold_to_cents(armors[groups[g][k]]->cost());
+			const double d = armors[groups[g][k]]->defense();
+			for (int64_t w = c; w <= budget_cents; w++){
+				if (previous[w - c] + d > current[w]){
+					current[w] = previous[w - c] + d;
+					choice[g][w] = k;
+				}
+			}
+		}
+		previous.swap(current);
+	}
+
+	std::vector<size_t> chosen;
+	int64_t w = budget_cents;
+	for (size_t g = groups.size(); g-- > 0; ){
+		if (choice[g][w] >= 0){
+			const size_t j = groups[g][choice[g][w]];
+			chosen.push_back(j);
+			w -= gold_to_cents(armors[j]->cost());
+		}
+	}
+	for (size_t k = chosen.size(); k-- > 0; ){
+		result->push_back(armors[chosen[k]]);
+	}
+	return result;
+}
@@ -0,0 +1,1115 @@
+///////////////////////////////////////////////////////////////////////////////
+// maxdefense_bench.cc
+//
+// Benchmarks for maxdefense.hh
+//
+// Run with no arguments to run every benchmark, or give the names of the
+// benchmarks to run, e.g. ./maxdefense_bench duplicates
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#include "armortable.hh"
+#include "maxdefense.hh"
+#include "timer.hh"
+
+
+// Counting allocator hook: every allocation in this program goes through these,
+// so that benchmarks can report the number of allocations and the live heap size.
+std::atomic<size_t> allocation_count(0);
+std::atomic<int64_t> live_heap_bytes(0);
+
+void* operator new(size_t size)
+{
+	void* p = std::malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	allocation_count++;
+	live_heap_bytes += malloc_usable_size(p);
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	if (p)
+	{
+		live_heap_bytes -= malloc_usable_size(p);
+		std::free(p);
+	}
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+
+// Make a synthetic catalog of n armor items with costs in [50, 1050) gold and
+// defense in [0, 1000) points, both rounded to the cent like armor.csv.
+// When distinct is nonzero, items are drawn from only that many (cost, defense) pairs.
+ArmorVector make_synthetic_armors(size_t n, size_t distinct = 0, unsigned seed = 335)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> cost_dist(50, 1050), defense_dist(0, 1000);
+	auto cents = [](double x) { return std::round(x * 100) / 100; };
+
+	std::vector<std::pair<double, double>> values;
+	for (size_t i = 0; i < distinct; i++)
+	{
+		values.push_back(std::make_pair(cents(cost_dist(rng)), cents(defense_dist(rng))));
+	}
+
+	ArmorVector armors;
+	armors.reserve(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		std::pair<double, double> value =
+			distinct
+			? values[rng() % distinct]
+			: std::make_pair(cents(cost_dist(rng)), cents(defense_dist(rng)))
+			;
+		armors.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("synthetic armor " + std::to_string(i), value.first, value.second)));
+	}
+	return armors;
+}
+
+
+// Make a random description in the style of armor.csv, e.g. "worn sub-par quality cursed orc belt".
+std::string make_synthetic_description(std::mt19937& rng)
+{
+	static const std::vector<std::vector<std::string>> words =
+	{
+		{ "used", "new", "like-new", "worn", "brittle", "deteriorating" },
+		{ "regular", "hardened", "poor quality", "sub-par quality", "high-quality", "master-quality" },
+		{ "regular", "lucky", "unlucky", "magic", "mystical", "enchanted", "divine", "cursed" },
+		{ "human", "elf", "orc", "dwarf" },
+		{ "chest plate", "shield", "helmet", "gloves", "gauntlets", "boots", "belt" }
+	};
+	std::string description;
+	for (auto& choices : words)
+	{
+		description += (description.empty() ? "" : " ") + choices[rng() % choices.size()];
+	}
+	return description;
+}
+
+
+// Total defense of a solution, for checking that solvers agree.
+double solution_defense(const ArmorVector& solution)
+{
+	double cost, defense;
+	sum_armor_vector(solution, cost, defense);
+	return defense;
+}
+
+
+// Search space of exhaustive search before and after collapsing duplicates,
+// and bounded_max_defense against dynamic_max_defense.
+void bench_duplicates(const ArmorVector& all_armors)
+{
+	auto report = [](const std::string& name, const ArmorVector& armors, double budget)
+	{
+		Timer timer;
+		auto groups = group_duplicate_armors(armors);
+		double group_seconds = timer.elapsed();
+
+		std::cout
+			<< name << ": " << armors.size() << " items in " << groups.size() << " groups"
+			<< " (grouping took " << group_seconds << " s)" << std::endl
+			<< "  search space 2^" << armors.size() << " -> 2^" << grouped_search_space_log2(groups) << std::endl
+			;
+
+		timer.reset();
+		auto dynamic = dynamic_max_defense(armors, budget);
+		double dynamic_seconds = timer.elapsed();
+
+		timer.reset();
+		auto bounded = bounded_max_defense(armors, budget);
+		double bounded_seconds = timer.elapsed();
+
+		std::cout
+			<< "  budget " << budget << ": dynamic " << dynamic_seconds << " s, bounded " << bounded_seconds << " s"
+			<< ", defense " << solution_defense(*dynamic) << " / " << solution_defense(*bounded) << std::endl
+			;
+	};
+
+	report("armor.csv", all_armors, 500);
+	report("synthetic, 50 distinct values", make_synthetic_armors(8064, 50), 5000);
+}
+
+
+// Items eliminated by prune_armor_vector, and its effect on the exact solvers.
+void bench_pruning(const ArmorVector& all_armors)
+{
+	for (double budget : { 500.0, 5000.0 })
+	{
+		size_t eliminated;
+		Timer timer;
+		auto pruned = prune_armor_vector(all_armors, budget, eliminated);
+		double prune_seconds = timer.elapsed();
+
+		timer.reset();
+		auto unpruned_solution = dynamic_max_defense(all_armors, budget);
+		double unpruned_seconds = timer.elapsed();
+
+		timer.reset();
+		auto pruned_solution = dynamic_max_defense(*pruned, budget);
+		double pruned_seconds = timer.elapsed();
+
+		std::cout
+			<< "armor.csv, budget " << budget << ": eliminated " << eliminated << " of " << all_armors.size()
+			<< " items in " << prune_seconds << " s" << std::endl
+			<< "  dynamic " << unpruned_seconds << " s -> " << pruned_seconds << " s"
+			<< ", defense " << solution_defense(*unpruned_solution) << " / " << solution_defense(*pruned_solution) << std::endl
+			;
+	}
+
+	ArmorVector first_items(all_armors.begin(), all_armors.begin() + 24);
+	size_t eliminated;
+	Timer timer;
+	auto unpruned_solution = exhaustive_max_defense(first_items, 1000);
+	double unpruned_seconds = timer.elapsed();
+
+	timer.reset();
+	auto pruned = prune_armor_vector(first_items, 1000, eliminated);
+	auto pruned_solution = exhaustive_max_defense(*pruned, 1000);
+	double pruned_seconds = timer.elapsed();
+
+	std::cout
+		<< "first 24 items, budget 1000: eliminated " << eliminated << std::endl
+		<< "  exhaustive " << unpruned_seconds << " s -> " << pruned_seconds << " s"
+		<< ", defense " << solution_defense(*unpruned_solution) << " / " << solution_defense(*pruned_solution) << std::endl
+		;
+}
+
+
+// Items fixed by reduced_max_defense, and the time saved by only solving the core.
+void bench_reduction(const ArmorVector& all_armors)
+{
+	for (double budget : { 500.0, 5000.0 })
+	{
+		Timer timer;
+		auto full_solution = dynamic_max_defense(all_armors, budget);
+		double full_seconds = timer.elapsed();
+
+		size_t fixed_count;
+		timer.reset();
+		auto reduced_solution = reduced_max_defense(all_armors, budget, dynamic_max_defense, fixed_count);
+		double reduced_seconds = timer.elapsed();
+
+		std::cout
+			<< "armor.csv, budget " << budget << ": fixed " << fixed_count << " of " << all_armors.size() << " items" << std::endl
+			<< "  dynamic " << full_seconds << " s -> reduced " << reduced_seconds << " s"
+			<< ", defense " << solution_defense(*full_solution) << " / " << solution_defense(*reduced_solution) << std::endl
+			;
+	}
+}
+
+
+// core_max_defense against branch_bound_max_defense and dynamic_max_defense on the full catalog,
+// and core_max_defense at several budgets on a large synthetic catalog.
+void bench_core(const ArmorVector& all_armors)
+{
+	auto run = [](const std::string& name, const ArmorSolver& solver, const ArmorVector& armors, double budget)
+	{
+		Timer timer;
+		auto solution = solver(armors, budget);
+		double seconds = timer.elapsed();
+		std::cout << "  " << name << ": " << seconds << " s, defense " << solution_defense(*solution) << std::endl;
+	};
+
+	for (double budget : { 500.0, 5000.0, 50000.0 })
+	{
+		std::cout << "armor.csv, budget " << budget << std::endl;
+		run("core", core_max_defense, all_armors, budget);
+		run("branch and bound", branch_bound_max_defense, all_armors, budget);
+
+		// The DP decision table needs one bit per item and budget cent.
+		double table_gb = all_armors.size() * budget * 100 / 8 / 1e9;
+		if (table_gb < 4)
+		{
+			run("dynamic", dynamic_max_defense, all_armors, budget);
+		}
+		else
+		{
+			std::cout << "  dynamic: skipped, decision table would need " << table_gb << " GB" << std::endl;
+		}
+	}
+
+	ArmorVector synthetic = make_synthetic_armors(1000000);
+	for (double budget : { 500.0, 5000.0, 50000.0, 500000.0 })
+	{
+		std::cout << "synthetic 1M items, budget " << budget << std::endl;
+		run("core", core_max_defense, synthetic, budget);
+	}
+}
+
+
+// Run f in a child process, so that its peak resident set size can be measured on its own,
+// and print the time it took and that peak.
+void run_measuring_memory(const std::string& name, std::function<void()> f)
+{
+	std::cout.flush();
+	pid_t child = fork();
+	if (child == 0)
+	{
+		Timer timer;
+		f();
+		double seconds = timer.elapsed();
+
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		std::cout << "  " << name << ": " << seconds << " s, peak RSS " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+		std::exit(0);
+	}
+	waitpid(child, nullptr, 0);
+}
+
+
+// hirschberg_max_defense against the decision-table reconstruction of dynamic_max_defense.
+void bench_hirschberg(const ArmorVector& all_armors)
+{
+	for (double budget : { 1000.0, 5000.0 })
+	{
+		std::cout << "armor.csv, budget " << budget << std::endl;
+		run_measuring_memory("decision table", [&]()
+		{
+			std::cout << "  defense " << solution_defense(*dynamic_max_defense(all_armors, budget)) << std::endl;
+		});
+		run_measuring_memory("hirschberg", [&]()
+		{
+			std::cout << "  defense " << solution_defense(*hirschberg_max_defense(all_armors, budget)) << std::endl;
+		});
+		run_measuring_memory("hirschberg, 4 threads", [&]()
+		{
+			std::cout << "  defense " << solution_defense(*hirschberg_max_defense(all_armors, budget, 2)) << std::endl;
+		});
+		run_measuring_memory("hirschberg, 4 threads per DP row", [&]()
+		{
+			std::cout << "  defense " << solution_defense(*hirschberg_max_defense(all_armors, budget, 0, 4)) << std::endl;
+		});
+	}
+}
+
+
+// Bitset reachability and exact_spend_max_defense against dynamic_max_defense.
+void bench_exact_spend(const ArmorVector& all_armors)
+{
+	std::vector<int64_t> costs_cents;
+	for (auto& armor : all_armors)
+	{
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+	}
+
+	for (double budget : { 500.0, 5000.0 })
+	{
+		Timer timer;
+		int64_t spend = closest_reachable_cents(costs_cents, budget_to_cents(budget));
+		double bitset_seconds = timer.elapsed();
+
+		timer.reset();
+		auto exact = exact_spend_max_defense(all_armors, budget);
+		double exact_seconds = timer.elapsed();
+
+		timer.reset();
+		auto dynamic = dynamic_max_defense(all_armors, budget);
+		double dynamic_seconds = timer.elapsed();
+
+		double exact_cost, exact_defense;
+		sum_armor_vector(*exact, exact_cost, exact_defense);
+		std::cout
+			<< "armor.csv, budget " << budget << ": closest spend " << spend / 100.0 << " gold" << std::endl
+			<< "  bitset reachability " << bitset_seconds << " s"
+			<< " (" << all_armors.size() * double(budget_to_cents(budget)) / bitset_seconds / 1e9 << " G item-cents/s)" << std::endl
+			<< "  exact spend " << exact_seconds << " s, cost " << exact_cost << ", defense " << exact_defense << std::endl
+			<< "  dynamic " << dynamic_seconds << " s, defense " << solution_defense(*dynamic) << std::endl
+			;
+	}
+}
+
+
+// knapsack_dp_row_tiled against the plain rolling knapsack_dp_row.
+// Bandwidth counts the 24 bytes a streaming kernel moves per cell: two loads and a store.
+void bench_dp_kernel(const ArmorVector& all_armors)
+{
+	std::vector<int64_t> costs_cents;
+	std::vector<double> defenses;
+	for (auto& armor : all_armors)
+	{
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+		defenses.push_back(armor->defense());
+	}
+
+	std::vector<std::pair<size_t, double>> cases = { { 8064, 500 }, { 8064, 5000 }, { 1000, 50000 } };
+	for (auto& test_case : cases)
+	{
+		const size_t n = test_case.first;
+		const int64_t budget_cents = budget_to_cents(test_case.second);
+
+		double cells = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			cells += std::max<int64_t>(0, budget_cents - costs_cents[i] + 1);
+		}
+
+		std::vector<double> naive_row, tiled_row;
+		Timer timer;
+		knapsack_dp_row(costs_cents, defenses, 0, n, budget_cents, naive_row);
+		double naive_seconds = timer.elapsed();
+
+		timer.reset();
+		knapsack_dp_row_tiled(costs_cents, defenses, 0, n, budget_cents, tiled_row);
+		double tiled_seconds = timer.elapsed();
+
+		std::cout
+			<< n << " items, budget " << test_case.second << " (row of " << (budget_cents + 1) * 8 / 1024 << " KB)"
+			<< (naive_row == tiled_row ? "" : " MISMATCH") << std::endl
+			<< "  naive: " << naive_seconds << " s, " << cells / naive_seconds / 1e9 << " G cells/s, "
+			<< cells * 24 / naive_seconds / 1e9 << " GB/s" << std::endl
+			<< "  tiled: " << tiled_seconds << " s, " << cells / tiled_seconds / 1e9 << " G cells/s, "
+			<< cells * 24 / tiled_seconds / 1e9 << " GB/s" << std::endl
+			;
+	}
+}
+
+
+// Strong scaling of knapsack_dp_row_parallel over the whole catalog at 100000 gold,
+// for thread counts up to the number of hardware threads.
+void bench_parallel_dp(const ArmorVector& all_armors)
+{
+	std::vector<int64_t> costs_cents;
+	std::vector<double> defenses;
+	for (auto& armor : all_armors)
+	{
+		costs_cents.push_back(gold_to_cents(armor->cost()));
+		defenses.push_back(armor->defense());
+	}
+	const int64_t budget_cents = budget_to_cents(100000);
+	const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	double one_thread_seconds = 0;
+	for (size_t threads = 1; threads <= hardware_threads; threads *= 2)
+	{
+		std::vector<double> row;
+		Timer timer;
+		knapsack_dp_row_parallel(costs_cents, defenses, 0, costs_cents.size(), budget_cents, row, threads);
+		double seconds = timer.elapsed();
+		if (threads == 1)
+		{
+			one_thread_seconds = seconds;
+		}
+
+		std::cout
+			<< all_armors.size() << " items, budget 100000, " << threads << " threads: " << seconds << " s"
+			<< ", speedup " << one_thread_seconds / seconds << ", best defense " << row.back() << std::endl
+			;
+	}
+}
+
+
+// Searches limited to at most k items against the unlimited exhaustive search.
+void bench_max_items(const ArmorVector& all_armors)
+{
+	ArmorVector first_items(all_armors.begin(), all_armors.begin() + 24);
+	Timer timer;
+	auto unlimited = exhaustive_max_defense(first_items, 2000);
+	std::cout
+		<< "first 24 items, budget 2000: exhaustive " << timer.elapsed() << " s"
+		<< ", " << unlimited->size() << " items, defense " << solution_defense(*unlimited) << std::endl
+		;
+
+	for (size_t max_items : { 1, 2, 3, 4, 6 })
+	{
+		timer.reset();
+		auto limited = exhaustive_max_defense_limited(first_items, 2000, max_items);
+		std::cout << "  at most " << max_items << " items: " << timer.elapsed() << " s, defense " << solution_defense(*limited) << std::endl;
+	}
+
+	for (size_t max_items : { 3, 6, 12 })
+	{
+		timer.reset();
+		auto limited = branch_bound_max_defense_limited(all_armors, 5000, max_items);
+		std::cout
+			<< "armor.csv, budget 5000, at most " << max_items << " items: branch and bound " << timer.elapsed() << " s"
+			<< ", defense " << solution_defense(*limited) << std::endl
+			;
+	}
+}
+
+
+// slot_max_defense on the full catalog, with the size of its search space.
+void bench_slots(const ArmorVector& all_armors)
+{
+	std::map<std::string, size_t> per_slot;
+	for (auto& armor : all_armors)
+	{
+		per_slot[armor_slot(armor->description())]++;
+	}
+	double bits = 0;
+	for (auto& slot : per_slot)
+	{
+		std::cout << "  " << slot.first << ": " << slot.second << " items" << std::endl;
+		bits += std::log2(slot.second + 1.0);
+	}
+	std::cout << "search space 2^" << all_armors.size() << " -> 2^" << bits << " loadouts" << std::endl;
+
+	for (double budget : { 500.0, 5000.0, 50000.0 })
+	{
+		Timer timer;
+		auto loadout = slot_max_defense(all_armors, budget);
+		std::cout
+			<< "armor.csv, budget " << budget << ": " << timer.elapsed() << " s"
+			<< ", " << loadout->size() << " items, defense " << solution_defense(*loadout) << std::endl
+			;
+	}
+}
+
+
+// Extra load time for the attribute columns, and filtering on them against substring search.
+void bench_attributes(const ArmorVector& all_armors)
+{
+	Timer timer;
+	auto plain = load_armor_table("armor.csv", false);
+	double plain_seconds = timer.elapsed();
+
+	timer.reset();
+	auto table = load_armor_table("armor.csv", true);
+	double attribute_seconds = timer.elapsed();
+
+	std::cout
+		<< "load_armor_table: " << plain_seconds << " s without attributes, " << attribute_seconds << " s with"
+		<< " (+" << (attribute_seconds - plain_seconds) / table->size() * 1e9 << " ns per row)" << std::endl
+		;
+
+	const int repeats = 1000;
+	size_t substring_matches = 0, attribute_matches = 0;
+	timer.reset();
+	for (int i = 0; i < repeats; i++)
+	{
+		for (auto& armor : all_armors)
+		{
+			substring_matches += (armor->description().find(" elf ") != std::string::npos);
+		}
+	}
+	double substring_seconds = timer.elapsed() / repeats;
+
+	timer.reset();
+	for (int i = 0; i < repeats; i++)
+	{
+		attribute_matches += select_attribute(*table, ATTRIBUTE_RACE, "elf").size();
+	}
+	double attribute_filter_seconds = timer.elapsed() / repeats;
+
+	std::cout
+		<< "race = elf: substring search " << substring_seconds * 1e6 << " us, attribute column "
+		<< attribute_filter_seconds * 1e6 << " us, speedup " << substring_seconds / attribute_filter_seconds
+		<< " (" << substring_matches / repeats << " / " << attribute_matches / repeats << " matches)" << std::endl
+		;
+}
+
+
+// Heap bytes per row of an ArmorVector against an ArmorTable with pooled descriptions.
+void bench_interning()
+{
+	auto measure = [](const std::string& name, std::function<ArmorVector()> make_rows)
+	{
+		int64_t before = live_heap_bytes;
+		ArmorVector rows = make_rows();
+		int64_t vector_bytes = live_heap_bytes - before;
+
+		before = live_heap_bytes;
+		ArmorTable table;
+		for (auto& row : rows)
+		{
+			table.append(row->description(), row->cost(), row->defense());
+		}
+		int64_t table_bytes = live_heap_bytes - before;
+
+		std::cout
+			<< name << ": " << rows.size() << " rows, " << table.pool().size() << " distinct descriptions, "
+			<< table.pool().word_count() << " distinct words" << std::endl
+			<< "  ArmorVector: " << double(vector_bytes) / rows.size() << " bytes per row" << std::endl
+			<< "  ArmorTable: " << double(table_bytes) / rows.size() << " bytes per row"
+			<< " (pool " << double(table.pool().memory_bytes()) / rows.size() << ")" << std::endl
+			;
+	};
+
+	measure("armor.csv", []() { return *load_armor_database("armor.csv"); });
+	measure("synthetic", []()
+	{
+		std::mt19937 rng(335);
+		ArmorVector rows;
+		rows.reserve(10000000);
+		for (size_t i = 0; i < 10000000; i++)
+		{
+			rows.push_back(std::shared_ptr<ArmorItem>(new ArmorItem(make_synthetic_description(rng), 50 + rng() % 100000 / 100.0, rng() % 100000 / 100.0)));
+		}
+		return rows;
+	});
+}
+// Write a database in the format of armor.csv with n synthetic rows, costs uniform in
+// [50, 1050) and defenses uniform in [0, 1000).
+void write_synthetic_database(const std::string& path, size_t n)
+{
+	std::mt19937 rng(335);
+	std::ofstream f(path);
+	f << "description^cost_gold^defense_points" << std::endl;
+	for (size_t i = 0; i < n; i++)
+	{
+		f << make_synthetic_description(rng) << "^" << (50 + rng() % 100000 / 100.0) << "^" << (rng() % 100000 / 100.0) << "\n";
+	}
+}
+
+
+void bench_arena()
+{
+	// A larger database than armor.csv, in the same format.
+	const std::string path = "/tmp/maxdefense_bench_armor.csv";
+	write_synthetic_database(path, 1000000);
+
+	auto measure = [](const std::string& name, std::function<std::unique_ptr<ArmorVector>()> load)
+	{
+		size_t allocations = allocation_count;
+		int64_t before = live_heap_bytes;
+		Timer timer;
+		std::unique_ptr<ArmorVector> armors = load();
+		double load_seconds = timer.elapsed();
+		allocations = allocation_count - allocations;
+		int64_t bytes = live_heap_bytes - before;
+
+		timer.reset();
+		size_t rows = armors->size();
+		armors.reset();
+		double free_seconds = timer.elapsed();
+
+		std::cout
+			<< "  " << name << ": " << allocations << " allocations (" << double(allocations) / rows << " per row), "
+			<< double(bytes) / rows << " bytes per row, load " << load_seconds << " s, free " << free_seconds << " s" << std::endl
+			;
+	};
+
+	for (const std::string& file : { std::string("armor.csv"), path })
+	{
+		std::cout << file << ":" << std::endl;
+		measure("load_armor_database", [&]() { return load_armor_database(file); });
+		measure("load_armor_database_arena", [&]() { return load_armor_database_arena(file); });
+	}
+
+	std::remove(path.c_str());
+}
+
+
+void bench_range_filter()
+{
+	const size_t n = 10000000;
+	ArmorVector armors = make_synthetic_armors(n);
+	// Only the defense column is filtered, so the rows share one description.
+	ArmorTable table;
+	for (auto& armor : armors)
+	{
+		table.append("synthetic armor", armor->cost(), armor->defense());
+	}
+
+	// Rows per second are over the whole catalog, so only meaningful for the full scans.
+	auto report = [&](const std::string& name, double seconds, size_t matches, bool full_scan)
+	{
+		std::cout << "    " << name << ": " << matches << " rows in " << seconds << " s";
+		if (full_scan)
+		{
+			std::cout << ", " << n / seconds / 1e6 << " M rows/s";
+		}
+		std::cout << std::endl;
+	};
+
+	// Defense is uniform in [0, 1000].
+	for (double selectivity : { 0.01, 0.1, 0.5, 0.9 })
+	{
+		const double min_defense = 500 - 500 * selectivity, max_defense = 500 + 500 * selectivity;
+		for (int total_size : { std::numeric_limits<int>::max(), 1000 })
+		{
+			std::cout << "  selectivity " << selectivity << ", total_size " << total_size << ":" << std::endl;
+
+			Timer timer;
+			auto filtered = filter_armor_vector(armors, min_defense, max_defense, total_size);
+			report("filter_armor_vector", timer.elapsed(), filtered->size(), total_size == std::numeric_limits<int>::max());
+
+			timer.reset();
+			RowSelection rows = select_defense_range(table, min_defense, max_defense, total_size);
+			report("select_defense_range", timer.elapsed(), rows.size(), total_size == std::numeric_limits<int>::max());
+		}
+	}
+}
+
+
+void bench_query()
+{
+	const std::string path = "/tmp/maxdefense_bench_armor.csv";
+	write_synthetic_database(path, 1000000);
+
+	// Costs are uniform in [50, 1050), so this keeps about 1% of the rows.
+	const ArmorQuery query = ArmorQuery().cost_range(50, 60);
+
+	// Heap is the live heap once the rows are loaded, which is the peak for load-then-filter.
+	auto measure = [](const std::string& name, std::function<std::unique_ptr<ArmorVector>()> load, const ArmorQuery* filter)
+	{
+		size_t allocations = allocation_count;
+		int64_t before = live_heap_bytes;
+		Timer timer;
+		std::unique_ptr<ArmorVector> armors = load();
+		int64_t bytes = live_heap_bytes - before;
+		if (filter)
+		{
+			armors = query_armor_vector(*armors, *filter);
+		}
+		double seconds = timer.elapsed();
+		allocations = allocation_count - allocations;
+
+		std::cout
+			<< "  " << name << ": " << armors->size() << " rows, " << seconds << " s, "
+			<< allocations << " allocations, " << bytes / 1024 << " KiB heap" << std::endl
+			;
+	};
+
+	measure("load_armor_database, then query_armor_vector", [&]() { return load_armor_database(path); }, &query);
+	measure("load_armor_database with query", [&]() { return load_armor_database(path, query); }, nullptr);
+	measure("load_armor_database_arena, then query_armor_vector", [&]() { return load_armor_database_arena(path); }, &query);
+	measure("load_armor_database_arena with query", [&]() { return load_armor_database_arena(path, query); }, nullptr);
+
+	std::remove(path.c_str());
+}
+
+
+void bench_streaming()
+{
+	const std::string path = "/tmp/maxdefense_bench_armor.csv";
+	write_synthetic_database(path, 1000000);
+
+	for (int total_size : { 6, 1000, 100000 })
+	{
+		Timer timer;
+		auto all_armors = load_armor_database(path);
+		auto filtered = filter_armor_vector(*all_armors, 1, 2500, total_size);
+		double load_then_filter = timer.elapsed();
+
+		timer.reset();
+		auto streamed = load_filtered_armor_database(path, 1, 2500, total_size);
+		double streaming = timer.elapsed();
+
+		std::cout
+			<< "  total_size " << total_size << ": load then filter " << load_then_filter << " s, streaming "
+			<< streaming << " s (" << streamed->size() << " items)" << std::endl
+			;
+	}
+
+	std::remove(path.c_str());
+}
+
+
+void bench_column_index()
+{
+	const size_t n = 10000000;
+	ArmorVector armors = make_synthetic_armors(n);
+	ArmorTable table;
+	for (auto& armor : armors)
+	{
+		table.append("synthetic armor", armor->cost(), armor->defense());
+	}
+	armors.clear();
+
+	Timer timer;
+	ColumnIndex index(table.defenses());
+	std::cout << "  build: " << timer.elapsed() << " s for " << n << " rows" << std::endl;
+
+	// Defense is uniform in [0, 1000], so a range of width w keeps a fraction w / 1000.
+	std::mt19937 rng(335);
+	for (double width : { 0.1, 1.0, 10.0 })
+	{
+		std::vector<double> starts;
+		for (int i = 0; i < 100; i++)
+		{
+			starts.push_back(std::uniform_real_distribution<double>(0, 1000 - width)(rng));
+		}
+
+		for (int total_size : { std::numeric_limits<int>::max(), 100 })
+		{
+			size_t scanned = 0, indexed = 0;
+			timer.reset();
+			for (double start : starts)
+			{
+				scanned += select_defense_range(table, start, start + width, total_size).size();
+			}
+			double scan_seconds = timer.elapsed();
+
+			timer.reset();
+			for (double start : starts)
+			{
+				indexed += index.first_rows(start, start + width, total_size).size();
+			}
+			double index_seconds = timer.elapsed();
+			assert(scanned == indexed);
+
+			std::cout
+				<< "  width " << width << ", total_size " << total_size << ", " << scanned / starts.size() << " rows per query: "
+				<< "scan " << starts.size() / scan_seconds << " queries/s, index " << starts.size() / index_seconds << " queries/s" << std::endl
+				;
+		}
+	}
+}
+
+
+void bench_token_index()
+{
+	const size_t n = 5000000;
+	std::mt19937 rng(335);
+	ArmorVector armors;
+	ArmorTable table;
+	armors.reserve(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		armors.push_back(std::shared_ptr<ArmorItem>(new ArmorItem(make_synthetic_description(rng), 50 + rng() % 100000 / 100.0, rng() % 100000 / 100.0)));
+		table.append(armors.back()->description(), armors.back()->cost(), armors.back()->defense());
+	}
+
+	Timer timer;
+	TokenIndex index(table);
+	std::cout
+		<< "  build: " << timer.elapsed() << " s, " << double(index.memory_bytes()) / n << " bytes per row" << std::endl
+		;
+
+	std::vector<std::vector<std::string>> queries = { { "elf", "shield" }, { "enchanted", "boots" }, { "cursed", "dwarf", "helmet" } };
+	for (auto& words : queries)
+	{
+		std::string name;
+		for (auto& word : words)
+		{
+			name += (name.empty() ? "" : " ") + word;
+		}
+
+		timer.reset();
+		size_t scanned = 0;
+		for (auto& armor : armors)
+		{
+			bool all = true;
+			for (auto& word : words)
+			{
+				all = all && armor->description().find(word) != std::string::npos;
+			}
+			scanned += all;
+		}
+		double scan_seconds = timer.elapsed();
+
+		timer.reset();
+		size_t indexed = index.all_of(words).size();
+		double index_seconds = timer.elapsed();
+
+		std::cout
+			<< "  " << name << ": substring scan " << scanned << " rows in " << scan_seconds << " s, "
+			<< "TokenIndex " << indexed << " rows in " << index_seconds << " s" << std::endl
+			;
+	}
+
+	timer.reset();
+	size_t any = index.any_of({ "boots", "gloves", "gauntlets" }).size();
+	std::cout << "  boots | gloves | gauntlets: " << any << " rows in " << timer.elapsed() << " s" << std::endl;
+}
+
+
+void bench_zone_map()
+{
+	const size_t n = 10000000;
+	std::mt19937 rng(335);
+	std::uniform_real_distribution<double> defense_dist(0, 1000);
+	std::vector<double> unsorted(n);
+	for (auto& defense : unsorted)
+	{
+		defense = defense_dist(rng);
+	}
+	std::vector<double> sorted = unsorted;
+	std::sort(sorted.begin(), sorted.end());
+
+	for (auto& column : { std::make_pair(std::string("sorted"), &sorted), std::make_pair(std::string("unsorted"), &unsorted) })
+	{
+		Timer timer;
+		ZoneMap zones(*column.second);
+		std::cout << "  " << column.first << ": " << zones.blocks() << " blocks, built in " << timer.elapsed() << " s" << std::endl;
+
+		for (double width : { 1.0, 10.0, 100.0 })
+		{
+			const double min_value = 500, max_value = 500 + width;
+
+			timer.reset();
+			RowSelection scanned;
+			select_range_span(column.second->data(), n, min_value, max_value, n, scanned);
+			double scan_seconds = timer.elapsed();
+
+			timer.reset();
+			size_t skipped;
+			RowSelection zoned = select_range_zoned(*column.second, zones, min_value, max_value, n, skipped);
+			double zoned_seconds = timer.elapsed();
+			assert(scanned == zoned);
+
+			std::cout
+				<< "    " << width / 10 << "% of rows: " << skipped << " blocks skipped, scan " << scan_seconds
+				<< " s, zoned " << zoned_seconds << " s, speedup " << scan_seconds / zoned_seconds << std::endl
+				;
+		}
+	}
+}
+
+
+void bench_filter_view(const ArmorVector& all_armors)
+{
+	auto measure = [](const std::string& name, std::function<std::unique_ptr<ArmorVector>()> run)
+	{
+		size_t allocations = allocation_count;
+		Timer timer;
+		std::unique_ptr<ArmorVector> result = run();
+		double seconds = timer.elapsed();
+		allocations = allocation_count - allocations;
+		std::cout << "    " << name << ": " << allocations << " allocations, " << seconds << " s, " << result->size() << " items" << std::endl;
+	};
+
+	for (int total_size : { 6, 20, 8064 })
+	{
+		std::cout << "  total_size " << total_size << ":" << std::endl;
+		measure("filter_armor_vector + greedy_max_defense", [&]()
+		{
+			return greedy_max_defense(*filter_armor_vector(all_armors, 1, 2500, total_size), 500);
+		});
+		measure("filter_view + greedy_max_defense_view", [&]()
+		{
+			return greedy_max_defense_view(filter_view(all_armors, ArmorQuery().defense_range(1, 2500).limit(total_size)), 500);
+		});
+		if (total_size <= 20)
+		{
+			measure("filter_armor_vector + exhaustive_max_defense", [&]()
+			{
+				return exhaustive_max_defense(*filter_armor_vector(all_armors, 1, 2500, total_size), 500);
+			});
+			measure("filter_view + exhaustive_max_defense_view", [&]()
+			{
+				return exhaustive_max_defense_view(filter_view(all_armors, ArmorQuery().defense_range(1, 2500).limit(total_size)), 500);
+			});
+		}
+	}
+
+	std::cout << "  two stages, cost <= 500 then shield, 100 items:" << std::endl;
+	measure("query_armor_vector x2 + greedy_max_defense", [&]()
+	{
+		auto cheap = query_armor_vector(all_armors, ArmorQuery().cost_range(0, 500));
+		return greedy_max_defense(*query_armor_vector(*cheap, ArmorQuery().keyword("shield").limit(100)), 500);
+	});
+	measure("filter_view x2 + greedy_max_defense_view", [&]()
+	{
+		return greedy_max_defense_view(filter_view(filter_view(all_armors, ArmorQuery().cost_range(0, 500)), ArmorQuery().keyword("shield").limit(100)), 500);
+	});
+}
+
+
+void bench_fused_greedy()
+{
+	const std::string path = "/tmp/maxdefense_bench_armor.csv";
+	write_synthetic_database(path, 1000000);
+
+	Timer timer;
+	auto armors = load_armor_database(path);
+	double vector_load = timer.elapsed();
+	timer.reset();
+	auto table = load_armor_table(path, false);
+	double table_load = timer.elapsed();
+	std::cout << "  load_armor_database " << vector_load << " s, load_armor_table " << table_load << " s" << std::endl;
+
+	// Best of three runs of each, after loading.
+	auto best_of = [](std::function<size_t()> run, size_t& items)
+	{
+		double best = std::numeric_limits<double>::infinity();
+		for (int i = 0; i < 3; i++)
+		{
+			Timer timer;
+			items = run();
+			best = std::min(best, timer.elapsed());
+		}
+		return best;
+	};
+
+	for (int total_size : { 1000, 100000, 1000000 })
+	{
+		for (double total_cost : { 500.0, 5000.0 })
+		{
+			size_t separate_items, fused_items;
+			double separate = best_of([&]()
+			{
+				return greedy_max_defense(*filter_armor_vector(*armors, 1, 2500, total_size), total_cost)->size();
+			}, separate_items);
+			double fused = best_of([&]()
+			{
+				return table->items(greedy_max_defense_fused(*table, 1, 2500, total_size, total_cost))->size();
+			}, fused_items);
+			assert(separate_items == fused_items);
+
+			std::cout
+				<< "  total_size " << total_size << ", total_cost " << total_cost << ", " << fused_items << " items: "
+				<< "filter + greedy " << separate << " s, fused " << fused << " s, speedup " << separate / fused << std::endl
+				;
+		}
+	}
+
+	std::remove(path.c_str());
+}
+void bench_parallel_filter()
+{
+	const size_t n = 50000000;
+	std::mt19937 rng(335);
+	std::uniform_real_distribution<double> defense_dist(0, 1000);
+	std::vector<double> column(n);
+	for (auto& defense : column)
+	{
+		defense = defense_dist(rng);
+	}
+	std::cout << "  " << n << " rows, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+	// 10% of the rows match.
+	for (size_t limit : { SIZE_MAX, size_t(1000000) })
+	{
+		Timer timer;
+		RowSelection serial;
+		select_range_span(column.data(), n, 450, 550, limit, serial);
+		double serial_seconds = timer.elapsed();
+		std::cout << "  limit " << (limit == SIZE_MAX ? std::string("none") : std::to_string(limit)) << ": serial " << serial_seconds << " s" << std::endl;
+
+		for (size_t threads : { 1, 2, 4, 8, 16, 32 })
+		{
+			timer.reset();
+			RowSelection rows = select_range_parallel(column, 450, 550, limit, threads);
+			double seconds = timer.elapsed();
+			assert(rows == serial);
+			std::cout << "    " << threads << " threads: " << seconds << " s, speedup " << serial_seconds / seconds << std::endl;
+		}
+	}
+}
+
+
+void bench_top_k()
+{
+	const size_t n = 10000000;
+	std::mt19937 rng(335);
+	std::uniform_real_distribution<double> cost_dist(50, 1050), defense_dist(0, 1000);
+	ArmorTable table;
+	for (size_t i = 0; i < n; i++)
+	{
+		const double cost = cost_dist(rng);
+		table.append("synthetic armor", cost, defense_dist(rng));
+	}
+
+	Timer timer;
+	std::vector<double> keys = ratio_keys(table);
+	std::cout << "  ratio_keys: " << timer.elapsed() << " s for " << n << " rows" << std::endl;
+
+	timer.reset();
+	RowSelection sorted(n);
+	std::iota(sorted.begin(), sorted.end(), 0);
+	std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+	std::cout << "  full sort: " << timer.elapsed() << " s" << std::endl;
+
+	for (size_t k : { 10, 40, 100, 1000 })
+	{
+		std::cout << "  k " << k << ":";
+		for (size_t threads : { 1, 4 })
+		{
+			timer.reset();
+			RowSelection rows = top_k_rows(keys, k, threads);
+			double seconds = timer.elapsed();
+			assert(rows == RowSelection(sorted.begin(), sorted.begin() + k));
+			std::cout << " " << threads << " threads " << seconds * 1000 << " ms;";
+		}
+
+		// nth_element over every row, for comparison.
+		timer.reset();
+		RowSelection all(n);
+		std::iota(all.begin(), all.end(), 0);
+		auto better = [&](uint32_t a, uint32_t b) { return keys[a] > keys[b] || (keys[a] == keys[b] && a < b); };
+		std::nth_element(all.begin(), all.begin() + k, all.end(), better);
+		std::sort(all.begin(), all.begin() + k, better);
+		std::cout << " nth_element over all rows " << timer.elapsed() * 1000 << " ms" << std::endl;
+	}
+}
+
+
+
+
+int main(int argc, char* argv[])
+{
+	auto all_armors = load_armor_database("armor.csv");
+	assert( all_armors );
+
+	std::vector<std::pair<std::string, std::function<void()>>> benchmarks =
+	{
+		{ "duplicates", [&]() { bench_duplicates(*all_armors); } },
+		{ "pruning", [&]() { bench_pruning(*all_armors); } },
+		{ "reduction", [&]() { bench_reduction(*all_armors); } },
+		{ "core", [&]() { bench_core(*all_armors); } },
+		{ "hirschberg", [&]() { bench_hirschberg(*all_armors); } },
+		{ "exact_spend", [&]() { bench_exact_spend(*all_armors); } },
+		{ "dp_kernel", [&]() { bench_dp_kernel(*all_armors); } },
+		{ "parallel_dp", [&]() { bench_parallel_dp(*all_armors); } },
+		{ "max_items", [&]() { bench_max_items(*all_armors); } },
+		{ "slots", [&]() { bench_slots(*all_armors); } },
+		{ "attributes", [&]() { bench_attributes(*all_armors); } },
+		{ "interning", [&]() { bench_interning(); } },
+		{ "arena", [&]() { bench_arena(); } },
+		{ "range_filter", [&]() { bench_range_filter(); } },
+		{ "query", [&]() { bench_query(); } },
+		{ "streaming", [&]() { bench_streaming(); } },
+		{ "column_index", [&]() { bench_column_index(); } },
+		{ "token_index", [&]() { bench_token_index(); } },
+		{ "zone_map", [&]() { bench_zone_map(); } },
+		{ "filter_view", [&]() { bench_filter_view(*all_armors); } },
+		{ "fused_greedy", [&]() { bench_fused_greedy(); } },
+		{ "parallel_filter", [&]() { bench_parallel_filter(); } },
+		{ "top_k", [&]() { bench_top_k(); } },
+	};
+
+	for (auto& benchmark : benchmarks)
+	{
+		bool selected = (argc == 1);
+		for (int i = 1; i < argc; i++)
+		{
+			selected = selected || (benchmark.first == argv[i]);
+		}
+
+		if (selected)
+		{
+			std::cout << "*** " << benchmark.first << " ***" << std::endl;
+			benchmark.second();
+			std::cout << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -5,10 +5,9 @@
 
 int main()
 {
-	auto all_armors = load_armor_database("armor.csv");
-	assert( all_armors );
+	auto filtered_armors = load_filtered_armor_database("armor.csv", 1, 2500, 6);
+	assert( filtered_armors );
 	std::unique_ptr<ArmorVector> soln_greedy, soln_exhaustive;
-	auto filtered_armors = filter_armor_vector(*all_armors, 1, 2500, 6);
 	Timer timer;
 	//soln_greedy = greedy_max_defense(*filtered_armors, 1000);
 	soln_exhaustive = exhaustive_max_defense(*filtered_armors,500);
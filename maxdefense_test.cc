@@ -7,9 +7,11 @@
 
 
 #include <cassert>
+#include <random>
 #include <sstream>
 
 
+#include "armortable.hh"
 #include "maxdefense.hh"
 #include "rubrictest.hh"
 
@@ -201,6 +203,1037 @@ int main()
 			}
 		}
 	);
+	
+	//
+	rubric.criterion(
+		"exhaustive_max_defense_multi matches exhaustive_max_defense", 2,
+		[&]()
+		{
+			std::vector<double> trivial_budgets = { 10, 100, 99, 150 };
+			auto trivial_solns = exhaustive_max_defense_multi(trivial_armors, trivial_budgets);
+			TEST_EQUAL("one solution per budget", trivial_budgets.size(), trivial_solns.size());
+			TEST_TRUE("empty solution", trivial_solns[0]->empty());
+			TEST_EQUAL("helmet only", "test helmet", (*trivial_solns[1])[0]->description());
+			TEST_EQUAL("boots only", "test boots", (*trivial_solns[2])[0]->description());
+			TEST_EQUAL("helmet and boots", 2, trivial_solns[3]->size());
+
+			std::vector<double> budgets = { 0, 250.5, 500, 1000, 2000, 4000 };
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 12);
+			auto solutions = exhaustive_max_defense_multi(*small_armors, budgets);
+
+			for ( size_t i = 0; i < budgets.size(); i++ )
+			{
+				auto expected = exhaustive_max_defense(*small_armors, budgets[i]);
+
+				double expected_cost, expected_defense, actual_cost, actual_defense;
+				sum_armor_vector(*expected, expected_cost, expected_defense);
+				sum_armor_vector(*solutions[i], actual_cost, actual_defense);
+
+				std::stringstream ss;
+				ss << "budget = " << budgets[i] << ", expected defense = " << expected_defense << " but found = " << actual_defense;
+				TEST_TRUE(ss.str(), std::abs(expected_defense - actual_defense) < 1e-6);
+				TEST_LE("within budget", actual_cost, budgets[i]);
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"IncrementalMaxDefense matches exhaustive_max_defense as items are added", 2,
+		[&]()
+		{
+			IncrementalMaxDefense solver;
+			TEST_TRUE("empty catalog", solver.best(2000)->empty());
+
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 14);
+			for ( size_t n = 1; n <= small_armors->size(); n++ )
+			{
+				solver.add_item((*small_armors)[n - 1]);
+				TEST_EQUAL("size", n, solver.armors().size());
+				TEST_GE("memory", solver.frontier_bytes(), solver.frontier_size() * sizeof(FrontierPoint));
+				TEST_GE("update time", solver.last_update_seconds(), 0.0);
+
+				ArmorVector prefix(small_armors->begin(), small_armors->begin() + n);
+				auto expected = exhaustive_max_defense(prefix, 2000);
+				auto actual = solver.best(2000);
+
+				double expected_cost, expected_defense, actual_cost, actual_defense;
+				sum_armor_vector(*expected, expected_cost, expected_defense);
+				sum_armor_vector(*actual, actual_cost, actual_defense);
+
+				std::stringstream ss;
+				ss << "n = " << n << ", expected defense = " << expected_defense << " but found = " << actual_defense;
+				TEST_TRUE(ss.str(), std::abs(expected_defense - actual_defense) < 1e-6);
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"dynamic_max_defense and bounded_max_defense match exhaustive_max_defense", 2,
+		[&]()
+		{
+			ArmorVector duplicated_armors;
+			for ( int copy = 0; copy < 4; copy++ )
+			{
+				duplicated_armors.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("test helmet", 100.0, 20.0)));
+				duplicated_armors.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("test boots", 40.0, 5.0)));
+				duplicated_armors.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("test belt", 30.25, 6.5)));
+			}
+
+			auto groups = group_duplicate_armors(duplicated_armors);
+			TEST_EQUAL("group count", 3, groups.size());
+			TEST_EQUAL("multiplicity", 4, groups[0].members.size());
+			TEST_EQUAL("search space", 3 * std::log2(5.0), grouped_search_space_log2(groups));
+
+			// Items that agree only to the cent are not interchangeable.
+			ArmorVector near_duplicates = {
+				std::make_shared<ArmorItem>("test ring", 10, 5.001),
+				std::make_shared<ArmorItem>("test amulet", 10, 5.004)
+			};
+			TEST_EQUAL("near duplicates", 2, group_duplicate_armors(near_duplicates).size());
+			double near_cost, near_defense;
+			sum_armor_vector(*bounded_max_defense(near_duplicates, 10), near_cost, near_defense);
+			TEST_TRUE("best near duplicate", std::abs(near_defense - 5.004) < 1e-9);
+
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 12);
+			for ( const ArmorVector* armors : { &trivial_armors, &duplicated_armors, small_armors.get() } )
+			{
+				for ( double budget : { 0.0, 99.0, 150.0, 290.75, 1000.0, 2000.0 } )
+				{
+					auto expected = exhaustive_max_defense(*armors, budget);
+					auto dynamic = dynamic_max_defense(*armors, budget);
+					auto bounded = bounded_max_defense(*armors, budget);
+
+					double expected_cost, expected_defense, dynamic_cost, dynamic_defense, bounded_cost, bounded_defense;
+					sum_armor_vector(*expected, expected_cost, expected_defense);
+					sum_armor_vector(*dynamic, dynamic_cost, dynamic_defense);
+					sum_armor_vector(*bounded, bounded_cost, bounded_defense);
+
+					std::stringstream ss;
+					ss
+						<< "budget = " << budget << ", expected defense = " << expected_defense
+						<< " but found = " << dynamic_defense << " (dynamic), " << bounded_defense << " (bounded)"
+						;
+					TEST_TRUE(ss.str(), std::abs(expected_defense - dynamic_defense) < 1e-6);
+					TEST_TRUE(ss.str(), std::abs(expected_defense - bounded_defense) < 1e-6);
+					TEST_LE("within budget", dynamic_cost, budget + 1e-9);
+					TEST_LE("within budget", bounded_cost, budget + 1e-9);
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"prune_armor_vector", 2,
+		[&]()
+		{
+			size_t eliminated = 0;
+			auto pruned = prune_armor_vector(trivial_armors, 99, eliminated);
+			TEST_EQUAL("over budget", 1, eliminated);
+			TEST_EQUAL("over budget", "test boots", (*pruned)[0]->description());
+
+			ArmorVector helmets;
+			for ( int copy = 0; copy < 4; copy++ )
+			{
+				helmets.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("test helmet", 100.0, 20.0)));
+			}
+			helmets.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("weak helmet", 100.0, 10.0)));
+			helmets.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("useless helmet", 10.0, 0.0)));
+			pruned = prune_armor_vector(helmets, 250, eliminated);
+			TEST_EQUAL("dominated", 4, eliminated);
+			TEST_EQUAL("dominated", 2, pruned->size());
+			TEST_TRUE("keeps the first copies", (*pruned)[0] == helmets[0] && (*pruned)[1] == helmets[1]);
+
+			pruned = prune_armor_vector(*filtered_armors, 500, eliminated);
+			TEST_GT("prunes the catalog", eliminated, 0);
+			TEST_EQUAL("counts", filtered_armors->size(), pruned->size() + eliminated);
+
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 14);
+			for ( double budget : { 100.0, 500.0, 1000.0, 2000.0 } )
+			{
+				auto small_pruned = prune_armor_vector(*small_armors, budget, eliminated);
+				double expected_cost, expected_defense, actual_cost, actual_defense;
+				sum_armor_vector(*exhaustive_max_defense(*small_armors, budget), expected_cost, expected_defense);
+				sum_armor_vector(*exhaustive_max_defense(*small_pruned, budget), actual_cost, actual_defense);
+				TEST_TRUE("same optimum after pruning", std::abs(expected_defense - actual_defense) < 1e-6);
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"reduced_max_defense", 2,
+		[&]()
+		{
+			size_t fixed_count = 0;
+			auto soln = reduced_max_defense(trivial_armors, 150, exhaustive_max_defense, fixed_count);
+			TEST_EQUAL("helmet and boots", 2, soln->size());
+			TEST_EQUAL("all fixed", 2, fixed_count);
+
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 20);
+			for ( double budget : { 100.0, 500.0, 1000.0, 2000.0, 3000.0 } )
+			{
+				double expected_cost, expected_defense, actual_cost, actual_defense;
+				sum_armor_vector(*exhaustive_max_defense(*small_armors, budget), expected_cost, expected_defense);
+				sum_armor_vector(*reduced_max_defense(*small_armors, budget, exhaustive_max_defense, fixed_count), actual_cost, actual_defense);
+				TEST_TRUE("same optimum as exhaustive", std::abs(expected_defense - actual_defense) < 1e-6);
+				TEST_LE("within budget", actual_cost, budget + 1e-9);
+			}
+
+			double expected_cost, expected_defense, actual_cost, actual_defense;
+			sum_armor_vector(*dynamic_max_defense(*filtered_armors, 500), expected_cost, expected_defense);
+			sum_armor_vector(*reduced_max_defense(*filtered_armors, 500, dynamic_max_defense, fixed_count), actual_cost, actual_defense);
+			TEST_TRUE("same optimum as dynamic", std::abs(expected_defense - actual_defense) < 1e-6);
+			TEST_GT("fixes most of the catalog", fixed_count, filtered_armors->size() / 2);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"branch_bound_max_defense and core_max_defense", 2,
+		[&]()
+		{
+			for ( ArmorSolver solver : { ArmorSolver(branch_bound_max_defense), ArmorSolver(core_max_defense) } )
+			{
+				auto soln = solver(trivial_armors, 99);
+				TEST_EQUAL("boots only", 1, soln->size());
+				TEST_EQUAL("boots only", "test boots", (*soln)[0]->description());
+				TEST_EQUAL("helmet and boots", 2, solver(trivial_armors, 150)->size());
+				TEST_TRUE("empty solution", solver(trivial_armors, 10)->empty());
+
+				auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 16);
+				std::vector<std::pair<const ArmorVector*, double>> cases =
+				{
+					{ small_armors.get(), 100 }, { small_armors.get(), 1000 }, { small_armors.get(), 2000 },
+					{ small_armors.get(), 20000 }, { filtered_armors.get(), 500 }
+				};
+				for ( auto& test_case : cases )
+				{
+					auto expected =
+						test_case.first->size() < 64
+						? exhaustive_max_defense(*test_case.first, test_case.second)
+						: dynamic_max_defense(*test_case.first, test_case.second)
+						;
+					double expected_cost, expected_defense, actual_cost, actual_defense;
+					sum_armor_vector(*expected, expected_cost, expected_defense);
+					sum_armor_vector(*solver(*test_case.first, test_case.second), actual_cost, actual_defense);
+
+					std::stringstream ss;
+					ss
+						<< "n = " << test_case.first->size() << ", budget = " << test_case.second
+						<< ", expected defense = " << expected_defense << " but found = " << actual_defense
+						;
+					TEST_TRUE(ss.str(), std::abs(expected_defense - actual_defense) < 1e-6);
+					TEST_LE("within budget", actual_cost, test_case.second + 1e-9);
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"hirschberg_max_defense matches dynamic_max_defense", 2,
+		[&]()
+		{
+			auto soln = hirschberg_max_defense(trivial_armors, 99);
+			TEST_EQUAL("boots only", 1, soln->size());
+			TEST_EQUAL("boots only", "test boots", (*soln)[0]->description());
+			TEST_EQUAL("helmet and boots", 2, hirschberg_max_defense(trivial_armors, 150)->size());
+			TEST_TRUE("empty solution", hirschberg_max_defense(trivial_armors, 10)->empty());
+
+			// An item that costs under a cent is charged a whole cent, so it never fits a budget it exceeds.
+			ArmorVector with_ring = {
+				std::make_shared<ArmorItem>("cheap ring", 0.004, 5),
+				std::make_shared<ArmorItem>("test helmet", 100, 20)
+			};
+			TEST_EQUAL("ring and helmet", 2, hirschberg_max_defense(with_ring, 150)->size());
+			TEST_EQUAL("ring only", 1, hirschberg_max_defense(with_ring, 50)->size());
+			TEST_EQUAL("helmet only", 1, hirschberg_max_defense(with_ring, 100)->size());
+			TEST_TRUE("nothing fits", hirschberg_max_defense(with_ring, 0)->empty());
+			for ( double budget : { 0.0, 0.004, 0.01, 50.0, 100.0, 100.004, 100.01, 150.0 } )
+			{
+				for ( auto armors : { &trivial_armors, &with_ring } )
+				{
+					double cost, defense, parallel_cost, parallel_defense, expected_cost, expected_defense;
+					sum_armor_vector(*hirschberg_max_defense(*armors, budget), cost, defense);
+					sum_armor_vector(*hirschberg_max_defense(*armors, budget, 1, 2), parallel_cost, parallel_defense);
+					sum_armor_vector(*dynamic_max_defense(*armors, budget), expected_cost, expected_defense);
+					TEST_LE("within budget", cost, budget);
+					TEST_LE("within budget", parallel_cost, budget);
+					TEST_TRUE("like dynamic_max_defense", std::abs(expected_defense - defense) < 1e-6);
+				}
+			}
+
+			ArmorVector some_armors(filtered_armors->begin(), filtered_armors->begin() + 400);
+			for ( double budget : { 0.0, 250.0, 500.0, 1234.56 } )
+			{
+				double expected_cost, expected_defense, serial_cost, serial_defense, parallel_cost, parallel_defense, row_cost, row_defense;
+				sum_armor_vector(*dynamic_max_defense(some_armors, budget), expected_cost, expected_defense);
+				sum_armor_vector(*hirschberg_max_defense(some_armors, budget), serial_cost, serial_defense);
+				sum_armor_vector(*hirschberg_max_defense(some_armors, budget, 2), parallel_cost, parallel_defense);
+				sum_armor_vector(*hirschberg_max_defense(some_armors, budget, 0, 3), row_cost, row_defense);
+				TEST_TRUE("serial", std::abs(expected_defense - serial_defense) < 1e-6);
+				TEST_TRUE("parallel", std::abs(expected_defense - parallel_defense) < 1e-6);
+				TEST_TRUE("parallel rows", std::abs(expected_defense - row_defense) < 1e-6);
+				TEST_LE("within budget", serial_cost, budget + 1e-9);
+				TEST_LE("within budget", parallel_cost, budget + 1e-9);
+				TEST_LE("within budget", row_cost, budget + 1e-9);
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"exact_spend_max_defense", 2,
+		[&]()
+		{
+			auto soln = exact_spend_max_defense(trivial_armors, 139.99);
+			TEST_EQUAL("helmet spends more", 1, soln->size());
+			TEST_EQUAL("helmet spends more", "test helmet", (*soln)[0]->description());
+			TEST_EQUAL("helmet and boots", 2, exact_spend_max_defense(trivial_armors, 150)->size());
+			TEST_TRUE("empty solution", exact_spend_max_defense(trivial_armors, 39.99)->empty());
+
+			// Compare against every subset.
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 12);
+			const int n = small_armors->size();
+			std::vector<int64_t> costs_cents;
+			for ( auto& armor : *small_armors )
+			{
+				costs_cents.push_back(gold_to_cents(armor->cost()));
+			}
+			for ( double budget : { 50.0, 700.0, 1500.5, 2000.0 } )
+			{
+				int64_t expected_spend = 0;
+				double expected_defense = 0;
+				for ( uint64_t bits = 0; bits < (uint64_t(1) << n); bits++ )
+				{
+					auto subset = armor_vector_from_mask(*small_armors, bits);
+					int64_t spend = 0;
+					for ( auto& armor : *subset )
+					{
+						spend += gold_to_cents(armor->cost());
+					}
+					double cost, defense;
+					sum_armor_vector(*subset, cost, defense);
+					if ( spend <= budget_to_cents(budget) && (spend > expected_spend || (spend == expected_spend && defense > expected_defense)) )
+					{
+						expected_spend = spend;
+						expected_defense = defense;
+					}
+				}
+
+				TEST_EQUAL("closest spend", expected_spend, closest_reachable_cents(costs_cents, budget_to_cents(budget)));
+
+				double actual_cost, actual_defense;
+				sum_armor_vector(*exact_spend_max_defense(*small_armors, budget), actual_cost, actual_defense);
+				TEST_EQUAL("exact spend", expected_spend, gold_to_cents(actual_cost));
+				TEST_TRUE("best defense at that spend", std::abs(expected_defense - actual_defense) < 1e-6);
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"knapsack_dp_row_tiled matches knapsack_dp_row", 2,
+		[&]()
+		{
+			std::vector<int64_t> costs_cents;
+			std::vector<double> defenses;
+			for ( size_t j = 0; j < 300; j++ )
+			{
+				costs_cents.push_back(gold_to_cents((*all_armors)[j]->cost()));
+				defenses.push_back((*all_armors)[j]->defense());
+			}
+			costs_cents.push_back(3);
+			defenses.push_back(1.5);
+			// An item that costs a fraction of a cent, and one that costs nothing.
+			costs_cents.insert(costs_cents.begin() + 5, gold_to_cents(0.004));
+			defenses.insert(defenses.begin() + 5, 5);
+			costs_cents.push_back(0);
+			defenses.push_back(2.25);
+
+			for ( int64_t budget_cents : { int64_t(0), int64_t(5), int64_t(77777) } )
+			{
+				std::vector<double> expected, actual;
+				knapsack_dp_row(costs_cents, defenses, 0, costs_cents.size(), budget_cents, expected);
+				for ( size_t items_per_pass : { 1, 3, 8 } )
+				{
+					for ( int64_t tile_cents : { 64, 2048 } )
+					{
+						knapsack_dp_row_tiled(costs_cents, defenses, 0, costs_cents.size(), budget_cents, actual, items_per_pass, tile_cents);
+						TEST_TRUE("same row", expected == actual);
+					}
+				}
+			}
+
+			// A negative budget leaves an empty row, whatever the row held before.
+			for ( int64_t budget_cents : { int64_t(-1), int64_t(-5) } )
+			{
+				std::vector<double> actual(10, 1.0);
+				knapsack_dp_row_tiled(costs_cents, defenses, 0, costs_cents.size(), budget_cents, actual);
+				TEST_TRUE("negative budget", actual.empty());
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"knapsack_dp_row_parallel matches knapsack_dp_row", 2,
+		[&]()
+		{
+			std::vector<int64_t> costs_cents;
+			std::vector<double> defenses;
+			for ( size_t j = 0; j < 200; j++ )
+			{
+				costs_cents.push_back(gold_to_cents((*all_armors)[j]->cost()));
+				defenses.push_back((*all_armors)[j]->defense());
+			}
+
+			for ( int64_t budget_cents : { int64_t(0), int64_t(3), int64_t(54321) } )
+			{
+				std::vector<double> expected, actual;
+				knapsack_dp_row(costs_cents, defenses, 0, costs_cents.size(), budget_cents, expected);
+				for ( size_t threads : { 1, 3, 4 } )
+				{
+					knapsack_dp_row_parallel(costs_cents, defenses, 0, costs_cents.size(), budget_cents, actual, threads);
+					TEST_TRUE("same row", expected == actual);
+				}
+			}
+
+			std::vector<double> negative(10, 1.0);
+			knapsack_dp_row(costs_cents, defenses, 0, costs_cents.size(), -5, negative);
+			TEST_TRUE("negative budget", negative.empty());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"max_items limit in exhaustive and branch-and-bound search", 2,
+		[&]()
+		{
+			TEST_EQUAL("helmet only", 1, exhaustive_max_defense_limited(trivial_armors, 150, 1)->size());
+			TEST_EQUAL("helmet only", "test helmet", (*branch_bound_max_defense_limited(trivial_armors, 150, 1))[0]->description());
+			TEST_TRUE("no items", exhaustive_max_defense_limited(trivial_armors, 150, 0)->empty());
+			TEST_TRUE("no items", branch_bound_max_defense_limited(trivial_armors, 150, 0)->empty());
+
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 14);
+			const int n = small_armors->size();
+			for ( size_t max_items : { 1, 2, 3, 5, 14 } )
+			{
+				for ( double budget : { 500.0, 2000.0, 5000.0 } )
+				{
+					double expected_defense = 0;
+					for ( uint64_t bits = 0; bits < (uint64_t(1) << n); bits++ )
+					{
+						if ( __builtin_popcountll(bits) <= max_items )
+						{
+							double cost, defense;
+							sum_armor_vector(*armor_vector_from_mask(*small_armors, bits), cost, defense);
+							if ( cost <= budget )
+							{
+								expected_defense = std::max(expected_defense, defense);
+							}
+						}
+					}
+
+					auto exhaustive = exhaustive_max_defense_limited(*small_armors, budget, max_items);
+					auto branch_bound = branch_bound_max_defense_limited(*small_armors, budget, max_items);
+					TEST_LE("max items", exhaustive->size(), max_items);
+					TEST_LE("max items", branch_bound->size(), max_items);
+
+					double exhaustive_cost, exhaustive_defense, branch_bound_cost, branch_bound_defense;
+					sum_armor_vector(*exhaustive, exhaustive_cost, exhaustive_defense);
+					sum_armor_vector(*branch_bound, branch_bound_cost, branch_bound_defense);
+
+					std::stringstream ss;
+					ss
+						<< "max items = " << max_items << ", budget = " << budget << ", expected defense = " << expected_defense
+						<< " but found = " << exhaustive_defense << " (exhaustive), " << branch_bound_defense << " (branch and bound)"
+						;
+					TEST_TRUE(ss.str(), std::abs(expected_defense - exhaustive_defense) < 1e-6);
+					TEST_TRUE(ss.str(), std::abs(expected_defense - branch_bound_defense) < 1e-6);
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"slot_max_defense", 2,
+		[&]()
+		{
+			TEST_EQUAL("slot", "chest plate", armor_slot("used high-quality mystical human chest plate"));
+			TEST_EQUAL("slot", "shield", armor_slot("deteriorating poor quality enchanted elf shield"));
+			TEST_EQUAL("slot", "boots", armor_slot("test boots"));
+			TEST_EQUAL("slot", "plate", armor_slot("test plate"));
+
+			TEST_EQUAL("helmet and boots", 2, slot_max_defense(trivial_armors, 150)->size());
+			ArmorVector helmets(trivial_armors);
+			helmets.push_back(std::shared_ptr<ArmorItem>(new ArmorItem("spare helmet", 50.0, 15.0)));
+			auto soln = slot_max_defense(helmets, 200);
+			TEST_EQUAL("one helmet", 2, soln->size());
+			TEST_EQUAL("one helmet", "test helmet", (*soln)[0]->description());
+
+			auto small_armors = filter_armor_vector(*filtered_armors, 1, 2000, 14);
+			const int n = small_armors->size();
+			for ( double budget : { 300.0, 1000.0, 2000.0, 5000.0 } )
+			{
+				double expected_defense = 0;
+				for ( uint64_t bits = 0; bits < (uint64_t(1) << n); bits++ )
+				{
+					auto subset = armor_vector_from_mask(*small_armors, bits);
+					std::map<std::string, int> per_slot;
+					bool valid = true;
+					for ( auto& armor : *subset )
+					{
+						valid = valid && (++per_slot[armor_slot(armor->description())] == 1);
+					}
+					double cost, defense;
+					sum_armor_vector(*subset, cost, defense);
+					if ( valid && cost <= budget )
+					{
+						expected_defense = std::max(expected_defense, defense);
+					}
+				}
+
+				auto loadout = slot_max_defense(*small_armors, budget);
+				std::map<std::string, int> per_slot;
+				for ( auto& armor : *loadout )
+				{
+					TEST_EQUAL("one item per slot", 1, ++per_slot[armor_slot(armor->description())]);
+				}
+				double actual_cost, actual_defense;
+				sum_armor_vector(*loadout, actual_cost, actual_defense);
+				TEST_LE("within budget", actual_cost, budget + 1e-9);
+				TEST_TRUE("same optimum as brute force", std::abs(expected_defense - actual_defense) < 1e-6);
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"ArmorTable attribute columns", 2,
+		[&]()
+		{
+			std::array<std::string, ATTRIBUTE_COUNT> tokens;
+			TEST_TRUE("parse", parse_armor_attributes("deteriorating poor quality enchanted elf shield", tokens));
+			TEST_EQUAL("condition", "deteriorating", tokens[ATTRIBUTE_CONDITION]);
+			TEST_EQUAL("quality", "poor quality", tokens[ATTRIBUTE_QUALITY]);
+			TEST_EQUAL("enchantment", "enchanted", tokens[ATTRIBUTE_ENCHANTMENT]);
+			TEST_EQUAL("race", "elf", tokens[ATTRIBUTE_RACE]);
+			TEST_EQUAL("slot", "shield", tokens[ATTRIBUTE_SLOT]);
+			TEST_FALSE("too short", parse_armor_attributes("test helmet", tokens));
+
+			auto table = load_armor_table("armor.csv", true);
+			TEST_TRUE("non-null", table);
+			TEST_EQUAL("size", all_armors->size(), table->size());
+			TEST_EQUAL("contents", (*all_armors)[9]->description(), table->description(9));
+			TEST_EQUAL("contents", (*all_armors)[9]->cost(), table->costs()[9]);
+			TEST_EQUAL("races", 4, table->dictionary(ATTRIBUTE_RACE).size());
+			TEST_EQUAL("slots", 7, table->dictionary(ATTRIBUTE_SLOT).size());
+			TEST_EQUAL("row 0", "human", table->dictionary(ATTRIBUTE_RACE).token(table->attribute(ATTRIBUTE_RACE)[0]));
+			TEST_EQUAL("row 0", "chest plate", table->dictionary(ATTRIBUTE_SLOT).token(table->attribute(ATTRIBUTE_SLOT)[0]));
+			TEST_EQUAL("unknown token", ATTRIBUTE_UNKNOWN, table->dictionary(ATTRIBUTE_RACE).code("goblin"));
+
+			RowSelection expected;
+			for ( size_t row = 0; row < all_armors->size(); row++ )
+			{
+				if ( (*all_armors)[row]->description().find(" elf ") != std::string::npos )
+				{
+					expected.push_back(row);
+				}
+			}
+			TEST_TRUE("select elf", expected == select_attribute(*table, ATTRIBUTE_RACE, "elf"));
+			TEST_TRUE("select goblin", select_attribute(*table, ATTRIBUTE_RACE, "goblin").empty());
+
+			auto by_slot = group_by_attribute(*table, ATTRIBUTE_SLOT);
+			TEST_EQUAL("slot groups", 7, by_slot.size());
+			for ( auto& group : by_slot )
+			{
+				TEST_EQUAL("slot group size", 1152, group.size());
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"DescriptionPool", 2,
+		[&]()
+		{
+			DescriptionPool pool;
+			uint32_t helmet = pool.intern("test helmet");
+			uint32_t boots = pool.intern("test boots");
+			TEST_NOT_EQUAL("distinct ids", helmet, boots);
+			TEST_EQUAL("same id", helmet, pool.intern("test helmet"));
+			TEST_EQUAL("size", 2, pool.size());
+			TEST_EQUAL("words", 3, pool.word_count());
+			TEST_EQUAL("round trip", "test boots", pool.description(boots));
+			uint32_t spaced = pool.intern(" odd  spacing ");
+			TEST_EQUAL("round trip", " odd  spacing ", pool.description(spaced));
+
+			for ( int i = 0; i < 1000; i++ )
+			{
+				TEST_EQUAL("grows", 3 + i, pool.intern("test item " + std::to_string(i)));
+			}
+			TEST_EQUAL("after growing", helmet, pool.intern("test helmet"));
+			TEST_EQUAL("after growing", "test item 999", pool.description(1002));
+
+			auto table = load_armor_table("armor.csv", false);
+			TEST_EQUAL("distinct descriptions", 8064, table->pool().size());
+			TEST_LT("few words", table->pool().word_count(), 40);
+			for ( size_t row = 0; row < table->size(); row += 97 )
+			{
+				TEST_EQUAL("round trip", (*all_armors)[row]->description(), table->description(row));
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"load_armor_database_arena", 1,
+		[&]()
+		{
+			auto arena_armors = load_armor_database_arena("armor.csv");
+			TEST_TRUE("loaded", arena_armors);
+			TEST_EQUAL("size", all_armors->size(), arena_armors->size());
+			for ( size_t i = 0; i < all_armors->size(); i++ )
+			{
+				TEST_EQUAL("description", (*all_armors)[i]->description(), (*arena_armors)[i]->description());
+				TEST_EQUAL("cost", (*all_armors)[i]->cost(), (*arena_armors)[i]->cost());
+				TEST_EQUAL("defense", (*all_armors)[i]->defense(), (*arena_armors)[i]->defense());
+			}
+
+			// Items outlive the vector they were loaded into.
+			std::shared_ptr<ArmorItem> kept = (*arena_armors)[5];
+			std::string description = kept->description();
+			arena_armors.reset();
+			TEST_EQUAL("kept alive", description, kept->description());
+			TEST_FALSE("missing file", load_armor_database_arena("no-such-file.csv"));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"select_defense_range", 2,
+		[&]()
+		{
+			auto table = load_armor_table("armor.csv", false);
+			for ( int total_size : { -1, 0, 1, 5, 1000, 100000 } )
+			{
+				for ( auto range : std::vector<std::pair<double, double>>{ { 0, 10 }, { 25.5, 30 }, { 100, 50 }, { 0, 1e9 } } )
+				{
+					auto expected = filter_armor_vector(*all_armors, range.first, range.second, total_size);
+					RowSelection rows = select_defense_range(*table, range.first, range.second, total_size);
+					TEST_EQUAL("size", expected->size(), rows.size());
+					for ( size_t i = 0; i < rows.size(); i++ )
+					{
+						TEST_EQUAL("same rows", (*expected)[i]->defense(), table->defenses()[rows[i]]);
+						TEST_EQUAL("same rows", (*expected)[i]->description(), table->description(rows[i]));
+					}
+				}
+			}
+
+			// Boundaries are inclusive, NaN never matches, and a tail shorter than a vector is handled.
+			std::vector<double> column = { 1, 2, std::nan(""), 3, 2, 4, 2 };
+			RowSelection rows;
+			select_range_span(column.data(), column.size(), 2, 3, 100, rows);
+			TEST_EQUAL("span", (RowSelection{ 1, 3, 4, 6 }), rows);
+			rows.clear();
+			select_range_span(column.data(), column.size(), 2, 3, 2, rows);
+			TEST_EQUAL("limit", (RowSelection{ 1, 3 }), rows);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"ArmorQuery", 2,
+		[&]()
+		{
+			auto check = [&](const ArmorQuery& query)
+			{
+				ArmorVector expected;
+				for ( auto& armor : *all_armors )
+				{
+					if ( expected.size() < query.limit()
+						&& armor->cost() >= 300 && armor->cost() <= 700
+						&& armor->defense() / armor->cost() >= 1.2
+						&& armor->description().find("shield") != std::string::npos
+						&& armor->description().find("elf") != std::string::npos )
+					{
+						expected.push_back(armor);
+					}
+				}
+				TEST_FALSE("nonempty", expected.empty());
+
+				auto filtered = query_armor_vector(*all_armors, query);
+				auto loaded = load_armor_database("armor.csv", query);
+				auto arena = load_armor_database_arena("armor.csv", query);
+				TEST_EQUAL("filter", expected, *filtered);
+				TEST_EQUAL("load size", expected.size(), loaded->size());
+				TEST_EQUAL("arena size", expected.size(), arena->size());
+				for ( size_t i = 0; i < expected.size(); i++ )
+				{
+					TEST_EQUAL("load", expected[i]->description(), (*loaded)[i]->description());
+					TEST_EQUAL("load", expected[i]->defense(), (*loaded)[i]->defense());
+					TEST_EQUAL("arena", expected[i]->description(), (*arena)[i]->description());
+					TEST_EQUAL("arena", expected[i]->cost(), (*arena)[i]->cost());
+				}
+			};
+
+			ArmorQuery query = ArmorQuery().cost_range(300, 700).min_ratio(1.2).keyword("shield").keyword("elf");
+			check(query);
+			check(query.limit(3));
+
+			auto defense = query_armor_vector(*all_armors, ArmorQuery().defense_range(20, 30).limit(50));
+			auto expected = filter_armor_vector(*all_armors, 20, 30, 50);
+			TEST_EQUAL("defense range", *expected, *defense);
+			TEST_EQUAL("everything", all_armors->size(), query_armor_vector(*all_armors, ArmorQuery())->size());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"load_filtered_armor_database", 1,
+		[&]()
+		{
+			for ( int total_size : { -1, 0, 1, 6, 100, 100000 } )
+			{
+				auto expected = filter_armor_vector(*all_armors, 100, 300, total_size);
+				auto loaded = load_filtered_armor_database("armor.csv", 100, 300, total_size);
+				TEST_TRUE("loaded", loaded);
+				TEST_EQUAL("size", expected->size(), loaded->size());
+				for ( size_t i = 0; i < expected->size(); i++ )
+				{
+					TEST_EQUAL("same items", (*expected)[i]->description(), (*loaded)[i]->description());
+					TEST_EQUAL("same items", (*expected)[i]->defense(), (*loaded)[i]->defense());
+				}
+			}
+			TEST_FALSE("missing file", load_filtered_armor_database("no-such-file.csv", 1, 2500, 6));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"ColumnIndex", 2,
+		[&]()
+		{
+			auto table = load_armor_table("armor.csv", false);
+			ColumnIndex defense_index(table->defenses()), cost_index(table->costs());
+			TEST_EQUAL("size", table->size(), defense_index.size());
+			for ( auto range : std::vector<std::pair<double, double>>{ { 0, 10 }, { 25.5, 30 }, { 100, 50 }, { 0, 1e9 }, { 300, 300.5 } } )
+			{
+				for ( int total_size : { 1, 6, 100000 } )
+				{
+					TEST_EQUAL("row order", select_defense_range(*table, range.first, range.second, total_size),
+						defense_index.first_rows(range.first, range.second, total_size));
+				}
+
+				RowSelection by_value = cost_index.range(range.first, range.second);
+				RowSelection scanned;
+				select_range_span(table->costs().data(), table->size(), range.first, range.second, table->size(), scanned);
+				TEST_EQUAL("same rows", scanned.size(), by_value.size());
+				for ( size_t i = 0; i < by_value.size(); i++ )
+				{
+					TEST_TRUE("in range", table->costs()[by_value[i]] >= range.first && table->costs()[by_value[i]] <= range.second);
+					TEST_TRUE("value order", i == 0 || table->costs()[by_value[i - 1]] <= table->costs()[by_value[i]]);
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"TokenIndex", 2,
+		[&]()
+		{
+			auto table = load_armor_table("armor.csv", false);
+			TokenIndex index(*table);
+
+			auto scan = [&](std::function<bool(const std::string&)> keep)
+			{
+				RowSelection rows;
+				for ( size_t row = 0; row < table->size(); row++ )
+				{
+					if ( keep(" " + table->description(row) + " ") )
+					{
+						rows.push_back(row);
+					}
+				}
+				return rows;
+			};
+			auto has = [](const std::string& padded, const std::string& word) { return padded.find(" " + word + " ") != std::string::npos; };
+
+			RowSelection elf_shields = index.all_of({ "elf", "shield" });
+			TEST_FALSE("nonempty", elf_shields.empty());
+			TEST_EQUAL("all_of", scan([&](const std::string& d) { return has(d, "elf") && has(d, "shield"); }), elf_shields);
+			TEST_EQUAL("any_of", scan([&](const std::string& d) { return has(d, "boots") || has(d, "belt"); }), index.any_of({ "boots", "belt" }));
+			TEST_EQUAL("rows", scan([&](const std::string& d) { return has(d, "enchanted"); }), index.rows("enchanted"));
+			TEST_TRUE("unknown word", index.rows("dragon").empty());
+			TEST_TRUE("unknown word", index.all_of({ "elf", "dragon" }).empty());
+			TEST_EQUAL("compose", elf_shields, intersect_rows(index.rows("shield"), index.rows("elf")));
+
+			// Feed the selection to the range filter and a solver.
+			RowSelection strong = select_range_rows(table->defenses(), elf_shields, 500, 1e9, 5);
+			TEST_EQUAL("limit", 5, strong.size());
+			auto items = table->items(strong);
+			for ( auto& item : *items )
+			{
+				TEST_TRUE("filtered", item->defense() >= 500 && has(" " + item->description() + " ", "elf"));
+			}
+			double cost, defense;
+			sum_armor_vector(*exhaustive_max_defense(*items, 2000), cost, defense);
+			TEST_LE("solver", cost, 2000);
+			TEST_GT("solver", defense, 0);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"ZoneMap", 2,
+		[&]()
+		{
+			// Sorted values, with a few NaN, and a partial last block.
+			std::vector<double> column;
+			for ( size_t row = 0; row < 10 * ZoneMap::BLOCK_ROWS + 123; row++ )
+			{
+				column.push_back(row % 1000 == 999 ? std::nan("") : row / 10.0);
+			}
+			ZoneMap zones(column);
+			TEST_EQUAL("blocks", 11, zones.blocks());
+			TEST_EQUAL("min", 0, zones.min(0));
+			TEST_TRUE("nan", zones.has_nan(0));
+
+			for ( auto range : std::vector<std::pair<double, double>>{ { 0, 100000 }, { 500, 2500 }, { 820, 830 }, { 5000, 4000 }, { 1e6, 2e6 } } )
+			{
+				for ( size_t limit : { size_t(10), size_t(100000) } )
+				{
+					RowSelection expected;
+					select_range_span(column.data(), column.size(), range.first, range.second, limit, expected);
+					size_t skipped;
+					TEST_EQUAL("same rows", expected, select_range_zoned(column, zones, range.first, range.second, limit, skipped));
+					TEST_LE("skipped", skipped, zones.blocks());
+				}
+			}
+			size_t skipped;
+			select_range_zoned(column, zones, 820, 830, 100000, skipped);
+			TEST_EQUAL("skips all but one block", 10, skipped);
+
+			auto table = load_armor_table("armor.csv", false);
+			TEST_EQUAL("table", select_defense_range(*table, 100, 200, 1000),
+				select_range_zoned(table->defenses(), ZoneMap(table->defenses()), 100, 200, 1000, skipped));
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"filter_view", 2,
+		[&]()
+		{
+			for ( int total_size : { 1, 10, 20, 1000 } )
+			{
+				auto filtered = filter_armor_vector(*all_armors, 100, 300, total_size);
+				auto view = filter_view(*all_armors, ArmorQuery().defense_range(100, 300).limit(total_size));
+				TEST_EQUAL("same items", *filtered, ArmorVector(view.begin(), view.end()));
+				TEST_EQUAL("greedy", *greedy_max_defense(*filtered, 2000), *greedy_max_defense_view(view, 2000));
+				if ( total_size <= 20 )
+				{
+					TEST_EQUAL("exhaustive", *exhaustive_max_defense(*filtered, 2000), *exhaustive_max_defense_view(view, 2000));
+				}
+			}
+
+			// Chained stages, each with its own limit.
+			auto chained = filter_view(filter_view(*all_armors, ArmorQuery().cost_range(0, 500).limit(200)), ArmorQuery().keyword("shield").limit(15));
+			auto staged = query_armor_vector(*query_armor_vector(*all_armors, ArmorQuery().cost_range(0, 500).limit(200)), ArmorQuery().keyword("shield").limit(15));
+			TEST_EQUAL("chained", *staged, ArmorVector(chained.begin(), chained.end()));
+			TEST_EQUAL("chained greedy", *greedy_max_defense(*staged, 1000), *greedy_max_defense_view(chained, 1000));
+			TEST_EQUAL("chained exhaustive", *exhaustive_max_defense(*staged, 1000), *exhaustive_max_defense_view(chained, 1000));
+
+			// Ties and unaffordable items.
+			ArmorVector ties = {
+				std::make_shared<ArmorItem>("a", 2, 4), std::make_shared<ArmorItem>("b", 1, 2),
+				std::make_shared<ArmorItem>("c", 50, 1000), std::make_shared<ArmorItem>("d", 1, 0),
+				std::make_shared<ArmorItem>("e", 3, 6)
+			};
+			TEST_EQUAL("ties", *greedy_max_defense(ties, 5), *greedy_max_defense_view(ties, 5));
+			TEST_EQUAL("empty", 0, greedy_max_defense_view(filter_view(ties, ArmorQuery().limit(0)), 5)->size());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"greedy_max_defense_fused", 2,
+		[&]()
+		{
+			auto table = load_armor_table("armor.csv", false);
+			for ( int total_size : { -1, 0, 6, 100, 100000 } )
+			{
+				for ( double total_cost : { 0.0, 100.0, 1000.0, 5000.0 } )
+				{
+					auto expected = greedy_max_defense(*filter_armor_vector(*all_armors, 1, 2500, total_size), total_cost);
+					auto fused = table->items(greedy_max_defense_fused(*table, 1, 2500, total_size, total_cost));
+					TEST_EQUAL("size", expected->size(), fused->size());
+					for ( size_t i = 0; i < expected->size(); i++ )
+					{
+						TEST_EQUAL("same items", (*expected)[i]->description(), (*fused)[i]->description());
+						TEST_EQUAL("same items", (*expected)[i]->cost(), (*fused)[i]->cost());
+					}
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"select_range_parallel", 1,
+		[&]()
+		{
+			std::mt19937 rng(335);
+			std::vector<double> column(1000000);
+			for ( auto& value : column )
+			{
+				value = rng() % 1000;
+			}
+			for ( size_t threads : { 1, 3, 8 } )
+			{
+				for ( size_t limit : { size_t(0), size_t(5), size_t(70000), size_t(200000), SIZE_MAX } )
+				{
+					RowSelection expected;
+					select_range_span(column.data(), column.size(), 100, 199, limit, expected);
+					TEST_EQUAL("same rows", expected, select_range_parallel(column, 100, 199, limit, threads));
+				}
+			}
+			TEST_TRUE("empty", select_range_parallel(std::vector<double>(), 0, 1, 10, 4).empty());
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"top_k_rows", 2,
+		[&]()
+		{
+			auto table = load_armor_table("armor.csv", false);
+			std::vector<double> keys = ratio_keys(*table);
+			TEST_EQUAL("ratio", table->defenses()[7] / table->costs()[7], keys[7]);
+
+			// Many ties, and a NaN.
+			std::vector<double> ties;
+			for ( size_t row = 0; row < 20000; row++ )
+			{
+				ties.push_back(row == 3 ? std::nan("") : double(row % 7));
+			}
+
+			for ( const std::vector<double>* column : std::vector<const std::vector<double>*>{ &keys, &table->defenses(), &ties } )
+			{
+				RowSelection all;
+				for ( size_t row = 0; row < column->size(); row++ )
+				{
+					if ( !std::isnan((*column)[row]) )
+					{
+						all.push_back(row);
+					}
+				}
+				std::stable_sort(all.begin(), all.end(), [&](uint32_t a, uint32_t b) { return (*column)[a] > (*column)[b]; });
+
+				for ( size_t k : { size_t(0), size_t(1), size_t(40), size_t(1000), size_t(100000) } )
+				{
+					RowSelection expected(all.begin(), all.begin() + std::min(k, all.size()));
+					for ( size_t threads : { 1, 3 } )
+					{
+						TEST_EQUAL("top k", expected, top_k_rows(*column, k, threads));
+					}
+				}
+			}
+
+			// The best-ratio items, solved exactly.
+			auto best = table->items(top_k_rows(keys, 40));
+			TEST_EQUAL("size", 40, best->size());
+			double cost, defense;
+			sum_armor_vector(*branch_bound_max_defense(*best, 500), cost, defense);
+			TEST_LE("budget", cost, 500);
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"cents-based solvers never exceed the budget with fractions of a cent", 1,
+		[&]()
+		{
+			ArmorVector over = { std::make_shared<ArmorItem>("x ring", 10.004, 5) };
+			ArmorVector under = { std::make_shared<ArmorItem>("cheap ring", 0.004, 5), std::make_shared<ArmorItem>("test helmet", 100, 20) };
+			for ( double budget : { 10.0, 100.0 } )
+			{
+				for ( auto armors : { &over, &under } )
+				{
+					std::vector<std::unique_ptr<ArmorVector>> solns;
+					solns.push_back(std::move(exhaustive_max_defense_multi(*armors, { budget })[0]));
+					IncrementalMaxDefense incremental;
+					for ( auto& armor : *armors )
+					{
+						incremental.add_item(armor);
+					}
+					solns.push_back(incremental.best(budget));
+					solns.push_back(dynamic_max_defense(*armors, budget));
+					solns.push_back(bounded_max_defense(*armors, budget));
+					solns.push_back(core_max_defense(*armors, budget));
+					solns.push_back(branch_bound_max_defense(*armors, budget));
+					solns.push_back(branch_bound_max_defense_limited(*armors, budget, 2));
+					solns.push_back(hirschberg_max_defense(*armors, budget));
+					solns.push_back(exhaustive_max_defense_limited(*armors, budget, 2));
+					solns.push_back(slot_max_defense(*armors, budget));
+					solns.push_back(exact_spend_max_defense(*armors, budget));
+					for ( auto& soln : solns )
+					{
+						double cost, defense;
+						sum_armor_vector(*soln, cost, defense);
+						TEST_LE("within budget", cost, budget);
+					}
+				}
+			}
+		}
+	);
+	
+	//
+	rubric.criterion(
+		"select_range_span matches a plain scan", 1,
+		[&]()
+		{
+			// Every pattern of four matches and misses, including NaN, across block boundaries,
+			// with starts and ends that are not multiples of four. Run make test_avx2 to check
+			// the AVX2 path too.
+			std::vector<double> column;
+			for ( size_t i = 0; i < 9000; i++ )
+			{
+				const size_t pattern = (i / 4) % 16;
+				column.push_back((pattern >> (i % 4)) & 1 ? 2.0 + (i % 3) * 0.5 : (i % 7 == 0 ? std::nan("") : 5.0 + i % 2));
+			}
+			for ( size_t first : { 0, 1, 3, 4095, 4097 } )
+			{
+				for ( size_t count : { size_t(0), size_t(7), size_t(4099), column.size() } )
+				{
+					for ( size_t limit : { size_t(0), size_t(5), size_t(2049), SIZE_MAX } )
+					{
+						RowSelection expected, actual = { 42 };
+						expected.push_back(42);
+						for ( size_t i = first; i < count && expected.size() < limit; i++ )
+						{
+							if ( column[i] >= 2 && column[i] <= 3 )
+							{
+								expected.push_back(i);
+							}
+						}
+						if ( expected.size() > limit )
+						{
+							expected.resize(limit);
+						}
+						select_range_span(column.data(), count, 2, 3, limit, actual, first);
+						TEST_EQUAL("same rows", expected, actual);
+					}
+				}
+			}
+		}
+	);
 
 	return rubric.run();
 }